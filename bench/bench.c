@@ -0,0 +1,299 @@
+/*** includes ***/
+
+// The editor core: the benchmarks call its functions directly, with no terminal involved.
+#include "../zen.h"
+
+/*** defines ***/
+
+#define BENCH_SCREEN_ROWS 48
+#define BENCH_SCREEN_COLS 160
+#define BENCH_NEEDLE "zen-bench-needle"
+
+/*** data ***/
+
+/*
+    Every benchmark runs passes over a whole corpus until at least B.mintime seconds have passed, and reports one line of
+    tab separated values:
+
+        label   bench   corpus  bytes   lines   ops     ns_per_op       mb_per_s
+
+    An op is one row, except for draw_rows where it is one frame. mb_per_s counts the bytes of text the benchmark went
+    through (the bytes written to the screen for draw_rows). 'label' is whatever was given with -l, to tell commits apart
+    when results are collected in one file.
+*/
+
+struct benchConfig
+{
+    const char *label;
+    const char *only_bench;
+    const char *only_corpus;
+    double mintime;
+};
+struct benchConfig B = {"-", NULL, NULL, 0.5};
+
+// Results that are not used go here, so the calls computing them are not optimized away.
+volatile int benchSink;
+
+/// @brief A synthetic corpus: writes line 'i' into 'buf' and returns its length.
+struct benchCorpus
+{
+    const char *name;
+    int (*line)(char *buf, long i);
+};
+
+/// @brief One pass of a benchmark over the buffer, adding the ops done and bytes gone through.
+struct benchCase
+{
+    const char *name;
+    void (*pass)(long long *ops, long long *bytes);
+};
+
+/*** corpora ***/
+
+/// @brief Short lines of C code.
+int benchLineShort(char *buf, long i)
+{
+    return sprintf(buf, "    x%ld = y%ld + %ld;", i % 97, i % 13, i);
+}
+
+/// @brief Long lines, around 2 KB each, like minified code or wide log records.
+int benchLineLong(char *buf, long i)
+{
+    int len = 0;
+    for (int j = 0; len < 2000; j++)
+        len += sprintf(&buf[len], "call_%ld(arg%d, \"str%d\", %ld) + ", (i + j) % 1000, j, j * 7, i * j);
+    return len;
+}
+
+/// @brief Lines indented and aligned with tabs.
+int benchLineTabs(char *buf, long i)
+{
+    return sprintf(buf, "%.*scase %ld:\tvalue\t= %ld;\tbreak;\t// %ld", (int)(i % 6) + 1, "\t\t\t\t\t\t", i, i * 3, i % 7);
+}
+
+/// @brief Mostly comments: a block comment every 8 lines, and code with line comments and strings in between.
+int benchLineComments(char *buf, long i)
+{
+    switch (i % 8)
+    {
+    case 0:
+        return sprintf(buf, "/*");
+    case 1:
+    case 2:
+    case 3:
+        return sprintf(buf, " * Comment line %ld, with \"quotes\" and 123 numbers that are not highlighted.", i);
+    case 4:
+        return sprintf(buf, " */");
+    default:
+        return sprintf(buf, "int f%ld = %ld; // trailing \"comment\" %ld", i, i % 100, i);
+    }
+}
+
+struct benchCorpus corpora[] = {
+    {"short", benchLineShort},
+    {"long", benchLineLong},
+    {"tabs", benchLineTabs},
+    {"comments", benchLineComments},
+};
+
+/// @brief Replace the buffer with 'bytes' bytes (rounded up to a whole line) of 'corpus'.
+void benchLoad(struct benchCorpus *corpus, long long bytes)
+{
+    editorDelRows(0, E->numrows);
+
+    // The lines are put in one block of text, and added to the buffer in one editorInsertRows() call.
+    char *text = malloc(bytes + 4096);
+    long n = 0, cap = 1024;
+    struct clipLine *lines = malloc(sizeof(struct clipLine) * cap);
+    long long len = 0;
+    while (len < bytes)
+    {
+        if (n == cap)
+        {
+            cap *= 2;
+            lines = realloc(lines, sizeof(struct clipLine) * cap);
+        }
+        lines[n].s = &text[len];
+        lines[n].len = corpus->line(&text[len], n);
+        len += lines[n].len;
+        n++;
+    }
+    editorInsertRows(0, lines, n);
+    free(lines);
+    free(text);
+    E->cx = E->cy = E->rowoff = E->coloff = 0;
+}
+
+/*** benchmarks ***/
+
+void benchUpdateRow(long long *ops, long long *bytes)
+{
+    for (int j = 0; j < E->numrows; j++)
+    {
+        editorUpdateRow(&E->row[j]);
+        *bytes += E->row[j].size;
+    }
+    *ops += E->numrows;
+}
+
+void benchUpdateSyntax(long long *ops, long long *bytes)
+{
+    for (int j = 0; j < E->numrows; j++)
+    {
+        editorUpdateSyntax(&E->row[j]);
+        *bytes += E->row[j].rsize;
+    }
+    *ops += E->numrows;
+}
+
+void benchCxToRx(long long *ops, long long *bytes)
+{
+    // The end of the row is the most expensive column to map.
+    for (int j = 0; j < E->numrows; j++)
+    {
+        benchSink = editorRowCxToRx(&E->row[j], E->row[j].size);
+        *bytes += E->row[j].size;
+    }
+    *ops += E->numrows;
+}
+
+void benchSearch(long long *ops, long long *bytes)
+{
+    // A needle that is not there makes the search go through every row, as a search that wraps around the file does.
+    char needle[] = BENCH_NEEDLE;
+    editorFindCallback(needle, 0);
+    for (int j = 0; j < E->numrows; j++)
+        *bytes += E->row[j].rsize;
+    *ops += E->numrows;
+}
+
+void benchRowsToString(long long *ops, long long *bytes)
+{
+    int len;
+    char *buf = editorRowsToString(&len);
+    free(buf);
+    *bytes += len;
+    *ops += E->numrows;
+}
+
+void benchDrawRows(long long *ops, long long *bytes)
+{
+    // Page through the whole file, one frame per screen.
+    for (int off = 0; off < E->numrows; off += E->screenrows)
+    {
+        struct abuf ab = ABUF_INIT;
+        E->rowoff = off;
+        editorDrawRows(&ab);
+        *bytes += ab.len;
+        (*ops)++;
+        abFree(&ab);
+    }
+    E->rowoff = 0;
+}
+
+struct benchCase benches[] = {
+    {"update_row", benchUpdateRow},
+    {"update_syntax", benchUpdateSyntax},
+    {"cx_to_rx", benchCxToRx},
+    {"search", benchSearch},
+    {"rows_to_string", benchRowsToString},
+    {"draw_rows", benchDrawRows},
+};
+
+/*** runner ***/
+
+double benchSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// @brief Run passes of 'bench' until B.mintime has passed, and print its result line.
+void benchRun(struct benchCase *bench, struct benchCorpus *corpus)
+{
+    long long ops = 0, bytes = 0;
+    double start = benchSeconds(), elapsed;
+    do
+    {
+        bench->pass(&ops, &bytes);
+        elapsed = benchSeconds() - start;
+    } while (elapsed < B.mintime);
+
+    printf("%s\t%s\t%s\t%lld\t%d\t%lld\t%.1f\t%.1f\n", B.label, bench->name, corpus->name, E->totalbytes, E->numrows, ops,
+           elapsed * 1e9 / (ops ? ops : 1), bytes / elapsed / 1e6);
+    fflush(stdout);
+}
+
+/// @brief Whether 'name' is in the comma separated 'list', or there is no list.
+int benchSelected(const char *list, const char *name)
+{
+    if (list == NULL)
+        return 1;
+    size_t len = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += len)
+    {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+void benchUsage()
+{
+    fprintf(stderr, "Usage: zen_bench [-s MB,MB,...] [-b BENCH,...] [-c CORPUS,...] [-t SECONDS] [-l LABEL]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    char default_sizes[] = "1,8";
+    char *sizes = default_sizes;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:c:t:l:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            sizes = optarg;
+            break;
+        case 'b':
+            B.only_bench = optarg;
+            break;
+        case 'c':
+            B.only_corpus = optarg;
+            break;
+        case 't':
+            B.mintime = atof(optarg);
+            break;
+        case 'l':
+            B.label = optarg;
+            break;
+        default:
+            benchUsage();
+        }
+    }
+
+    editorNewBuffer();
+    E->screenrows = BENCH_SCREEN_ROWS;
+    E->screencols = BENCH_SCREEN_COLS;
+    E->filename = strdup("bench.c");
+    editorSelectSyntaxHighlight();
+
+    printf("label\tbench\tcorpus\tbytes\tlines\tops\tns_per_op\tmb_per_s\n");
+    for (char *size = strtok(sizes, ","); size; size = strtok(NULL, ","))
+    {
+        for (unsigned int c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++)
+        {
+            if (!benchSelected(B.only_corpus, corpora[c].name))
+                continue;
+            benchLoad(&corpora[c], (long long)(atof(size) * 1048576));
+            for (unsigned int b = 0; b < sizeof(benches) / sizeof(benches[0]); b++)
+            {
+                if (benchSelected(B.only_bench, benches[b].name))
+                    benchRun(&benches[b], &corpora[c]);
+            }
+        }
+    }
+    return 0;
+}
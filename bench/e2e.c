@@ -0,0 +1,461 @@
+/*** includes ***/
+
+// The editor core and its frontend, without a terminal: files are opened, edited, searched and saved through the same
+// functions the event loop calls, and the frames it draws go to /dev/null.
+#include "../zen.h"
+
+#include <dirent.h>
+
+/*** defines ***/
+
+#define E2E_SCREEN_ROWS 48
+#define E2E_SCREEN_COLS 160
+#define E2E_LINE_MAX ((1 << 20) + 4096) // Longest line a corpus writes, plus room for its last record.
+#define E2E_NEEDLE "zen-e2e-needle"
+
+/*** data ***/
+
+/*
+    For every size and corpus, a file is generated, opened the way the editor opens it, and every step a user would wait
+    for is timed. Each run reports one line of tab separated values:
+
+        label  corpus  bytes  lines  paint_ms  load_ms  rss_mb  heap_mb  key_top_us  key_mid_us  key_end_us  key_max_us
+        search_ms  save_ms  reopen_ms
+
+    paint_ms is the time from editorOpen() to the first frame drawn, load_ms the time until the whole file is in (the
+    same as paint_ms for files small enough to be loaded before the first frame). rss_mb and heap_mb are the resident
+    memory of the process and the memory the editor counts for itself (see editorMemReport()) once the file is loaded.
+    key_*_us are the median latency of a keystroke, with the frame it causes, on the first, middle and last line, and
+    key_max_us the slowest of them all. search_ms is a search from the top for a needle on the last line, save_ms writing
+    the file back, and reopen_ms the first frame again when the file is opened a second time, through its sidecar cache.
+*/
+
+struct e2eConfig
+{
+    const char *label;
+    const char *only_corpus;
+    const char *dir;     // Where the work directory is created.
+    const char *memdir;  // If set, the full memory report of every run is written here.
+    int keys;            // Keystrokes timed at each position.
+    char workdir[4096];  // Generated files and their sidecar caches, removed at exit.
+    FILE *out;           // The results, on what was stdout.
+    uint64_t rng;
+};
+struct e2eConfig B = {"-", NULL, NULL, NULL, 200, "", NULL, 0};
+
+/// @brief A synthetic corpus: writes line 'i' into 'buf' (E2E_LINE_MAX bytes) and returns its length, without the newline.
+struct e2eCorpus
+{
+    const char *name;
+    const char *ext; // Picks the filetype, like the extension of a real file.
+    int (*line)(char *buf, long i);
+};
+
+/*** corpora ***/
+
+/// @brief Deterministic pseudo random numbers (xorshift64), so every run generates the same files.
+uint64_t e2eRandom()
+{
+    B.rng ^= B.rng << 13;
+    B.rng ^= B.rng >> 7;
+    B.rng ^= B.rng << 17;
+    return B.rng;
+}
+
+/// @brief C source: functions with comments, keywords, strings and numbers, 12 lines each.
+int e2eLineC(char *buf, long i)
+{
+    long f = i / 12;
+    switch (i % 12)
+    {
+    case 0:
+        return sprintf(buf, "/* Function %ld: checks the range of its input and returns the scaled value. */", f);
+    case 1:
+        return sprintf(buf, "static int compute_%ld(int value, const char *name)", f);
+    case 2:
+        return sprintf(buf, "{");
+    case 3:
+        return sprintf(buf, "    // Reject values that are out of range.");
+    case 4:
+        return sprintf(buf, "    if (value < %d || value > %d)", (int)(e2eRandom() % 100), (int)(e2eRandom() % 100000));
+    case 5:
+        return sprintf(buf, "        return -1;");
+    case 6:
+        return sprintf(buf, "    for (int i = 0; i < value; i++)");
+    case 7:
+        return sprintf(buf, "        total_%ld += i * %d;", f, (int)(e2eRandom() % 1000));
+    case 8:
+        return sprintf(buf, "    printf(\"%%s: %%d\\n\", name, value);");
+    case 9:
+        return sprintf(buf, "    return total_%ld / 2;", f);
+    case 10:
+        return sprintf(buf, "}");
+    default:
+        return 0;
+    }
+}
+
+/// @brief Server log records.
+int e2eLineLog(char *buf, long i)
+{
+    static const char *levels[] = {"INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR"};
+    static const char *methods[] = {"GET", "GET", "POST", "PUT", "DELETE"};
+    uint64_t r = e2eRandom();
+    return sprintf(buf, "2026-03-01T%02ld:%02ld:%02ld.%03dZ %s [worker-%d] %s /api/v1/items/%d status=%d bytes=%d dur_ms=%d",
+                   i / 3600000 % 24, i / 60000 % 60, i / 1000 % 60, (int)(i % 1000), levels[r % 6], (int)(r >> 8) % 16,
+                   methods[(r >> 16) % 5], (int)(r >> 24) % 100000, (r >> 40) % 10 ? 200 : 404, (int)(r >> 44) % 65536,
+                   (int)(r >> 56) % 250);
+}
+
+/// @brief Minified JSON: one array of records per line, each line about 1 MB. A real minified file is often one line,
+/// but rows are int-sized, so lines are capped to keep files of any size loadable.
+int e2eLineJson(char *buf, long i)
+{
+    int len = sprintf(buf, "[");
+    for (long j = 0; len < (1 << 20); j++)
+    {
+        uint64_t r = e2eRandom();
+        len += sprintf(&buf[len], "%s{\"id\":%ld,\"name\":\"item-%d\",\"tags\":[\"t%d\",\"t%d\"],\"price\":%d.%02d,\"active\":%s,\"meta\":{\"rev\":%d}}",
+                       j ? "," : "", i * 100000 + j, (int)(r % 1000000), (int)(r >> 20) % 50, (int)(r >> 26) % 50,
+                       (int)(r >> 32) % 1000, (int)(r >> 42) % 100, (r >> 49) & 1 ? "true" : "false", (int)(r >> 50) % 64);
+    }
+    buf[len++] = ']';
+    return len;
+}
+
+/// @brief CSV: a header, then records of mixed fields.
+int e2eLineCsv(char *buf, long i)
+{
+    static const char *countries[] = {"DE", "FR", "IN", "JP", "US", "BR", "NG", "AU"};
+    if (i == 0)
+        return sprintf(buf, "id,timestamp,user,email,country,amount,status");
+    uint64_t r = e2eRandom();
+    return sprintf(buf, "%ld,2026-03-01 %02ld:%02ld:%02ld,user%d,user%d@example.com,%s,%d.%02d,%s", i, i / 3600 % 24, i / 60 % 60,
+                   i % 60, (int)(r % 100000), (int)(r % 100000), countries[(r >> 20) % 8], (int)(r >> 24) % 10000,
+                   (int)(r >> 40) % 100, (r >> 50) & 1 ? "paid" : "open");
+}
+
+struct e2eCorpus corpora[] = {
+    {"c", ".c", e2eLineC},
+    {"log", ".log", e2eLineLog},
+    {"json", ".json", e2eLineJson},
+    {"csv", ".csv", e2eLineCsv},
+};
+
+/// @brief Write 'bytes' bytes (rounded up to a whole line) of 'corpus' to 'path', then a last line with the search needle.
+/// Returns the size of the file.
+long long e2eGenerate(struct e2eCorpus *corpus, const char *path, long long bytes)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        perror(path);
+        exit(1);
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+    char *buf = malloc(E2E_LINE_MAX);
+    long long len = 0;
+    B.rng = 0x9e3779b97f4a7c15ULL;
+    for (long i = 0; len < bytes; i++)
+    {
+        int n = corpus->line(buf, i);
+        buf[n++] = '\n';
+        fwrite(buf, 1, n, fp);
+        len += n;
+    }
+    len += fprintf(fp, "%s\n", E2E_NEEDLE);
+    free(buf);
+    if (fclose(fp) == EOF)
+    {
+        perror(path);
+        exit(1);
+    }
+    return len;
+}
+
+/*** measurements ***/
+
+double e2eSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// @brief Resident memory of the process, in bytes.
+long long e2eResident()
+{
+    long pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return 0;
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return (long long)resident * sysconf(_SC_PAGESIZE);
+}
+
+/// @brief Replace the current buffer with a new, empty one of the benchmark's screen size.
+void e2eNewBuffer()
+{
+    if (E)
+        editorFreeBuffer(E);
+    malloc_trim(0); // So the resident memory of one run does not include what the last one freed.
+    editorNewBuffer();
+    E->screenrows = E2E_SCREEN_ROWS - 2;
+    E->screencols = E2E_SCREEN_COLS;
+}
+
+/// @brief Open 'path' and draw its first frame. Returns the time it took.
+double e2eOpen(char *path)
+{
+    double start = e2eSeconds();
+    if (editorOpen(path) == -1)
+    {
+        perror(path);
+        exit(1);
+    }
+    editorRefreshScreen();
+    return e2eSeconds() - start;
+}
+
+/// @brief Turn the rest of the file into rows, the way the event loop does while the user looks at the first screen.
+void e2eLoadWait()
+{
+    while (E->load.active)
+    {
+        struct pollfd pfd = {E->load.notify[0], POLLIN, 0};
+        if (poll(&pfd, 1, -1) > 0)
+            editorLoadService();
+    }
+}
+
+int e2eCompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/// @brief Type B.keys keys on row 'at', each followed by its frame: a character, then a backspace taking it away again.
+/// Returns the median latency in microseconds, and raises '*worst' to the slowest one.
+double e2eKeys(int at, double *worst)
+{
+    E->cy = at;
+    E->cx = 0;
+    editorRefreshScreen(); // Scrolling there is not part of the keystrokes.
+
+    double *lat = malloc(sizeof(double) * B.keys);
+    for (int k = 0; k < B.keys; k++)
+    {
+        double start = e2eSeconds();
+        editorProcessKey(k % 2 ? BACKSPACE : 'x');
+        editorRefreshScreen();
+        lat[k] = (e2eSeconds() - start) * 1e6;
+        if (lat[k] > *worst)
+            *worst = lat[k];
+    }
+    qsort(lat, B.keys, sizeof(double), e2eCompareDouble);
+    double median = lat[B.keys / 2];
+    free(lat);
+    return median;
+}
+
+/// @brief Generate 'bytes' of 'corpus', and time everything a user waits for on it.
+void e2eRun(struct e2eCorpus *corpus, long long bytes, const char *size)
+{
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/%s-%s%s", B.workdir, corpus->name, size, corpus->ext);
+    long long filesize = e2eGenerate(corpus, path, bytes);
+
+    // Open, first frame, and the rest of the file coming in.
+    e2eNewBuffer();
+    double start = e2eSeconds();
+    double paint = e2eOpen(path);
+    e2eLoadWait();
+    double load = e2eSeconds() - start;
+
+    long long rss = e2eResident(), heap = 0;
+    for (int i = 0; i < MEM_CATEGORIES; i++)
+        heap += zenHeap.bytes[i];
+    if (B.memdir)
+    {
+        char mempath[4200];
+        snprintf(mempath, sizeof(mempath), "%s/mem-%s-%s.tsv", B.memdir, corpus->name, size);
+        FILE *fp = fopen(mempath, "w");
+        if (fp == NULL)
+        {
+            perror(mempath);
+            exit(1);
+        }
+        editorMemReport(fp);
+        fclose(fp);
+    }
+
+    // Keystrokes at the top, in the middle, and at the end of the file. They leave the text as it was.
+    double worst = 0;
+    double key_top = e2eKeys(0, &worst);
+    double key_mid = e2eKeys(E->numrows / 2, &worst);
+    double key_end = e2eKeys(E->numrows - 1, &worst);
+
+    // A search from the top that only matches on the last line goes through the whole file.
+    E->cy = E->cx = 0;
+    char needle[] = E2E_NEEDLE;
+    start = e2eSeconds();
+    editorFindCallback(needle, 0);
+    double search = e2eSeconds() - start;
+    if (E->cy != E->numrows - 1)
+    {
+        fprintf(stderr, "zen_e2e: %s: the search did not find the needle on the last line\n", path);
+        exit(1);
+    }
+    editorFindCallback(needle, '\r');
+
+    start = e2eSeconds();
+    if (editorSave() == -1)
+    {
+        fprintf(stderr, "zen_e2e: %s: %s\n", path, E->statusmsg);
+        exit(1);
+    }
+    double save = e2eSeconds() - start;
+    struct stat st;
+    if (stat(path, &st) == -1 || st.st_size != filesize)
+    {
+        fprintf(stderr, "zen_e2e: %s: saved %lld bytes, generated %lld\n", path, (long long)st.st_size, filesize);
+        exit(1);
+    }
+
+    // Opening the file again goes through the sidecar cache written when it was loaded (or saved).
+    int numrows = E->numrows;
+    e2eNewBuffer();
+    double reopen = e2eOpen(path);
+    e2eLoadWait();
+    if (E->numrows != numrows)
+    {
+        fprintf(stderr, "zen_e2e: %s: reopened with %d lines, loaded with %d\n", path, E->numrows, numrows);
+        exit(1);
+    }
+
+    fprintf(B.out, "%s\t%s\t%lld\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n", B.label, corpus->name,
+            filesize, numrows, paint * 1e3, load * 1e3, rss / 1048576.0, heap / 1048576.0, key_top, key_mid, key_end, worst,
+            search * 1e3, save * 1e3, reopen * 1e3);
+    fflush(B.out);
+
+    e2eNewBuffer();
+    unlink(path);
+}
+
+/*** runner ***/
+
+/// @brief Remove the files in 'path', and 'path' itself once it is empty.
+void e2eRemoveDir(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return;
+    struct dirent *ent;
+    char file[4400];
+    while ((ent = readdir(dir)) != NULL)
+    {
+        snprintf(file, sizeof(file), "%s/%s", path, ent->d_name);
+        if (ent->d_name[0] != '.')
+            unlink(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+/// @brief Remove the work directory: the generated files, and the sidecar caches under zen/.
+void e2eCleanup()
+{
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/zen", B.workdir);
+    e2eRemoveDir(path);
+    e2eRemoveDir(B.workdir);
+}
+
+/// @brief Whether 'name' is in the comma separated 'list', or there is no list.
+int e2eSelected(const char *list, const char *name)
+{
+    if (list == NULL)
+        return 1;
+    size_t len = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += len)
+    {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+void e2eUsage()
+{
+    fprintf(stderr, "Usage: zen_e2e [-s MB,MB,...] [-c CORPUS,...] [-k KEYS] [-d DIR] [-m MEMDIR] [-l LABEL]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    char default_sizes[] = "1,16";
+    char *sizes = default_sizes;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:k:d:m:l:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            sizes = optarg;
+            break;
+        case 'c':
+            B.only_corpus = optarg;
+            break;
+        case 'k':
+            B.keys = atoi(optarg);
+            break;
+        case 'd':
+            B.dir = optarg;
+            break;
+        case 'm':
+            B.memdir = optarg;
+            break;
+        case 'l':
+            B.label = optarg;
+            break;
+        default:
+            e2eUsage();
+        }
+    }
+    // Keystrokes come in pairs that cancel out, so the file saved is the file generated.
+    if (B.keys < 2)
+        e2eUsage();
+    B.keys += B.keys % 2;
+
+    if (B.dir == NULL)
+        B.dir = getenv("TMPDIR") && *getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    snprintf(B.workdir, sizeof(B.workdir), "%s/zen-e2e-XXXXXX", B.dir);
+    if (mkdtemp(B.workdir) == NULL)
+    {
+        perror(B.workdir);
+        return 1;
+    }
+    atexit(e2eCleanup);
+    // Keep the sidecar caches out of the user's cache, and start every run cold.
+    setenv("XDG_CACHE_HOME", B.workdir, 1);
+
+    // The frames the editor draws go to /dev/null, the results to what was stdout.
+    B.out = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    fprintf(B.out, "label\tcorpus\tbytes\tlines\tpaint_ms\tload_ms\trss_mb\theap_mb\tkey_top_us\tkey_mid_us\tkey_end_us\tkey_max_us\tsearch_ms\tsave_ms\treopen_ms\n");
+    fflush(B.out);
+    for (char *size = strtok(sizes, ","); size; size = strtok(NULL, ","))
+    {
+        for (unsigned int c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++)
+        {
+            if (e2eSelected(B.only_corpus, corpora[c].name))
+                e2eRun(&corpora[c], (long long)(atof(size) * 1048576), size);
+        }
+    }
+    return 0;
+}
@@ -1,153 +1,96 @@
 /*** includes ***/
 
-// Feature test macro : https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
-// We add them above our includes, because the header files we’re including use the macros to decide what features to expose.
-#define _DEFAULT_SOURCE
-#define _BSD_SOURCE
-#define _GNU_SOURCE
-
-#include <ctype.h>
-#include <errno.h>
-#include <fcntl.h>
-#include <stdio.h>
-#include <stdarg.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/ioctl.h>
-#include <sys/types.h>
-#include <termios.h>
-#include <time.h>
-#include <unistd.h>
-
-/*** defines ***/
-
-#define ZEN_VERSION "0.0.1"
-#define ZEN_TAB_STOP 4
-#define ZEN_QUIT_TIMES 3
+#include "zen.h"
 
-/*
-    The 'CTRL_KEY' macro bitwise-ANDs a character with the value 00011111, in binary.
-    (In C, you generally specify bitmasks using hexadecimal, since C doesn’t have binary literals, and hexadecimal is more concise and
-    readable once you get used to it.)
-
-    In other words, it sets the upper 3 bits of the character to 0.
-    This mirrors what the Ctrl key does in the terminal: it strips bits 5 and 6 from whatever key you press in combination with Ctrl,
-    and sends that.
-    (By convention, bit numbering starts from 0.) The ASCII character set seems to be designed this way on purpose.
-    (It is also similarly designed so that you can set and clear bit 5 to switch between lowercase and uppercase.)
-*/
-#define CTRL_KEY(k) ((k) & 0x1f)
-
-enum editorKey
-{
-    BACKSPACE = 127,
-    ARROW_LEFT = 1000,
-    ARROW_RIGHT,
-    ARROW_UP,
-    ARROW_DOWN,
-    DEL_KEY,
-    HOME_KEY,
-    END_KEY,
-    PAGE_UP,
-    PAGE_DOWN
-};
+/*** data ***/
 
-enum editorHighlight
+/// @brief The terminal the editor runs on, which outlives the buffers shown on it.
+struct editorTerminal
 {
-    HL_NORMAL = 0,
-    HL_COMMENT,
-    HL_MLCOMMENT,
-    HL_KEYWORD1,
-    HL_KEYWORD2,
-    HL_STRING,
-    HL_NUMBER,
-    HL_MATCH
+    struct termios orig_termios;
+    int raw;                              // orig_termios holds the attributes to put back.
+    volatile sig_atomic_t resize_pending; // Set by the SIGWINCH handler, consumed by the event loop.
+    int prompting;                        // Nesting depth of editorPrompt(), whose callbacks keep row state between keys.
 };
+struct editorTerminal zenTerminal;
 
-#define HL_HIGHLIGHT_NUMBERS (1 << 0)
-#define HL_HIGHLIGHT_STRINGS (1 << 1)
-
-/*** data ***/
-
-/// @brief struct that will contain all the syntax highlighting information for a particular filetype.
-struct editorSyntax
+/// @brief State of the resident server started with 'zen --server'. Buffers stay loaded between the terminals that attach to it.
+struct editorServer
 {
-    char *filetype;                 // The filetype field is the name of the filetype that will be displayed to the user in the status bar.
-    char **filematch;               // filematch is an array of strings, where each string contains a pattern to match a filename against. If the filename matches, then the file will be recognized as having that filetype.
-    char **keywords;                // NULL-terminated array of strings, each string containing a keyword. To differentiate between the two types of keywords, terminate the second type of keywords with a pipe (|) character (also known as a vertical bar).
-    char *singleline_comment_start; // let each language specify its own single-line comment pattern
-    char *multiline_comment_start;
-    char *multiline_comment_end;
-    int flags; // flags is a bit field that will contain flags for whether to highlight numbers and whether to highlight strings for that filetype. eg HL_HIGHLIGHT_NUMBERS
+    int listenfd;                 // Listening socket, -1 when not running as a server.
+    int client;                   // Connection of the attached client (or, in the client, of the server), -1 if none.
+    int quit;                     // The attached client pressed Ctrl-Q: detach and wait for the next one.
+    struct editorConfig **buffers; // Buffers kept resident between sessions, keyed by filename.
+    int nbuffers;
+    jmp_buf session_abort; // die() during a session jumps back here instead of taking the server down.
 };
+struct editorServer zenServer = {.listenfd = -1, .client = -1};
 
-/// @brief Data type for storing a row of text in our editor.
-typedef struct erow
-{
-    int idx; // erow knows its own index within the file.
-    int size;
-    int rsize; // Contains the size of the contents of 'render'.
-    char *chars;
-    char *render;      // Contains the actual characters to draw on the screen for that row of text.
-    unsigned char *hl; // store the highlighting of each line in an array
-    int hl_open_comment;
-} erow;
-
-struct editorConfig
-{
-    int cx, cy; // Cursor co-ordinates
-    int rx;     // x variable index into the render field.
-    int rowoff; // Keep track of what row of the file the user is currently scrolled to
-    int coloff; // Keep track of what col of the file the user is currently scrolled to
-    int numrows;
-    erow *row;
-    int dirty;
-    int screenrows;
-    int screencols;
-    char *filename;
-    char statusmsg[80];
-    time_t statusmsg_time;
-    struct editorSyntax *syntax; // When E.syntax is NULL, that means there is no filetype for the current file, and no syntax highlighting should be done
-    struct termios orig_termios;
+/// @brief A tool connected to the remote control socket, with the bytes of its not yet complete request line, and the
+/// responses it has not read yet. Its socket is non-blocking, so a tool that stops reading never stalls the editor.
+struct remoteClient
+{
+    int fd;
+    char *buf;
+    int len;
+    char *out;
+    size_t outlen, outpos, outcap; // Bytes queued, and how many of them were sent.
+    int closing;                   // The tool is done sending: it is disconnected once its responses are sent.
 };
-struct editorConfig E;
-
-/*** filetypes ***/
 
-char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
-
-char *C_HL_keywords[] = {
-    "switch", "if", "while", "for", "break", "continue", "return", "else",
-    "struct", "union", "typedef", "static", "enum", "class", "case",
-    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
-    "void|", NULL};
-
-/// @brief HLDB stands for “highlight database”
-struct editorSyntax HLDB[] = {
-    {"c",
-     C_HL_extensions,
-     C_HL_keywords,
-     "//", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS},
+/// @brief Remote control socket opened with --listen=PATH, for driving the editor from scripts.
+struct editorRemote
+{
+    int listenfd; // -1 when not listening.
+    char *path;
+    struct remoteClient clients[ZEN_REMOTE_CLIENTS];
+    int nclients;
 };
+struct editorRemote zenRemote = {.listenfd = -1};
 
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+/// @brief Keyboard macro: the keys recorded between two Ctrl-R presses.
+struct editorMacro
+{
+    int *keys;
+    int len;
+    int cap;
+    int recording;
+    int playing; // While set, editorReadKey() returns the recorded keys instead of reading the terminal.
+    int pos;     // Next key to play back.
+};
+struct editorMacro zenMacro;
 
 /*** prototypes ***/
 
-void editorSetStatusMessage(const char *fmt, ...);
-void editorRefreshScreen();
-char *editorPrompt(char *prompt, void (*callback)(char *, int));
+int editorDecodeKey(char c);
+int editorBackgroundWait();
+void editorHandleResize();
+void editorIdle();
+void editorProcessKeypress();
+void editorRemotePoll();
+int editorRemotePending(struct pollfd *fds);
+void editorRemoteSent(struct pollfd *fds, int n);
+void editorServerPollClient();
+void editorServerTurnAway();
 
 /*** terminal ***/
 
 /// @brief Function that prints an error message and exits the program.
 void die(const char *s)
 {
+    int err = errno;
     // Clear the screen on exit
     write(STDOUT_FILENO, "\x1b[2J", 4);
     write(STDOUT_FILENO, "\x1b[H", 3);
 
+    // In the server, an error (usually the client's terminal going away) only ends that client's session. The client
+    // prints what it is sent, our own stderr is nobody's.
+    if (zenServer.listenfd != -1 && zenServer.client != -1)
+    {
+        dprintf(zenServer.client, "zen: %s: %s\n", s, strerror(err));
+        longjmp(zenServer.session_abort, 1);
+    }
+    errno = err;
     /*
         Most C library functions that fail will set the global errno variable to indicate what the error was.
         perror() looks at the global errno variable and prints a descriptive error message for it.
@@ -160,7 +103,10 @@ void die(const char *s)
 /// @brief Restore original terminal attributes when progeam exits.
 void disableRawMode()
 {
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
+    if (!zenTerminal.raw)
+        return;
+    zenTerminal.raw = 0; // Once only, even if it fails and dies.
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &zenTerminal.orig_termios) == -1)
         die("tcsetattr");
 }
 
@@ -173,12 +119,17 @@ void enableRawMode()
         (2) modifying the struct by hand
         (3) passing the modified struct to tcsetattr() to write the new terminal attributes back out.
     */
-    if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1) // Get current Terminal attributes
+    if (tcgetattr(STDIN_FILENO, &zenTerminal.orig_termios) == -1) // Get current Terminal attributes
         die("tcgetattr");
+    zenTerminal.raw = 1;
 
     // register our disableRawMode() function to be called automatically when the program exits, whether it exits by returning from main(), or by calling the exit() function
-    atexit(disableRawMode);
-    struct termios raw = E.orig_termios;
+    // The server enables raw mode once per attached terminal, but must only register it once.
+    static int registered = 0;
+    if (!registered)
+        atexit(disableRawMode);
+    registered = 1;
+    struct termios raw = zenTerminal.orig_termios;
 
     /*
         By default your terminal starts in canonical mode, also called cooked mode.
@@ -228,19 +179,38 @@ void enableRawMode()
         die("tcsetattr");
 }
 
-/// @brief Wait for one keypress, and return it.
-int editorReadKey()
+/// @brief Wait for one keypress on the terminal, and return it.
+int editorReadTerminalKey()
 {
     int nread;
     char c;
 
+    // While a filter command runs or a file is being loaded, wait on them as well as on the terminal, and only read() once a key is there.
+    while ((E->pipe.pid || E->load.active || editorRemotePending(NULL)) && !editorBackgroundWait())
+        ;
+    editorAutosave();
+
     // Read in char c
     while ((nread = read(STDIN_FILENO, &c, 1)) != 1)
     {
-        if (nread == -1 && errno != EAGAIN)
+        // A signal (SIGWINCH) interrupting read() is not an error.
+        if (nread == -1 && errno != EAGAIN && errno != EINTR)
             die("read");
+
+        // read() timed out without a keypress: the terminal has been quiet for VTIME, do background work.
+        if (nread == 0)
+            editorIdle();
     }
 
+    uint64_t t = editorPerfNow();
+    int key = editorDecodeKey(c);
+    editorPerfEnd(PERF_DECODE, t);
+    return key;
+}
+
+/// @brief Turn the byte 'c' just read into a key, reading the rest of an escape sequence if it starts one.
+int editorDecodeKey(char c)
+{
     // If we read the escape character => special key press
     if (c == '\x1b')
     {
@@ -316,6 +286,26 @@ int editorReadKey()
     }
 }
 
+/// @brief Return the next key: from the macro being played back if there is one, otherwise from the terminal.
+/// Keys are recorded here rather than in editorProcessKeypress(), so that what is typed into prompts (Ctrl-F) is replayed too.
+int editorReadKey()
+{
+    if (zenMacro.playing)
+        return zenMacro.pos < zenMacro.len ? zenMacro.keys[zenMacro.pos++] : '\x1b'; // A prompt asking for more keys than were recorded gets cancelled.
+
+    int c = editorReadTerminalKey();
+    if (zenMacro.recording)
+    {
+        if (zenMacro.len == zenMacro.cap)
+        {
+            zenMacro.cap = zenMacro.cap ? zenMacro.cap * 2 : 64;
+            zenMacro.keys = realloc(zenMacro.keys, sizeof(int) * zenMacro.cap);
+        }
+        zenMacro.keys[zenMacro.len++] = c;
+    }
+    return c;
+}
+
 int getCursorPosition(int *rows, int *cols)
 {
     char buf[32];
@@ -375,763 +365,426 @@ int getWindowSize(int *rows, int *cols)
     }
 }
 
-/*** syntax highlighting ***/
-
-/// @brief Takes a character and returns true if it’s considered a separator character.
-int is_separator(int c)
+/// @brief SIGWINCH handler. Only records that a resize happened, the relayout is done from the event loop.
+void handleSigWinch(int sig)
 {
-    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+    (void)sig;
+    zenTerminal.resize_pending = 1;
 }
 
-void editorUpdateSyntax(erow *row)
+void installSignalHandlers()
 {
-    row->hl = realloc(row->hl, row->rsize);
-    memset(row->hl, HL_NORMAL, row->rsize);
-
-    if (E.syntax == NULL)
-        return;
-
-    char **keywords = E.syntax->keywords;
-
-    // Single line and multi line comments.
-    char *scs = E.syntax->singleline_comment_start;
-    char *mcs = E.syntax->multiline_comment_start;
-    char *mce = E.syntax->multiline_comment_end;
-
-    int scs_len = scs ? strlen(scs) : 0;
-    int mcs_len = mcs ? strlen(mcs) : 0;
-    int mce_len = mce ? strlen(mce) : 0;
-
-    // 'prev_sep' keeps track of whether the previous character was a separator.
-    int prev_sep = 1;
-
-    // 'in_string' keeps track of whether we are currently inside a string.
-    int in_string = 0;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handleSigWinch;
+    sigemptyset(&sa.sa_mask);
+    // No SA_RESTART: we want read() to return with EINTR so the event loop sees the resize.
+    sa.sa_flags = 0;
+    if (sigaction(SIGWINCH, &sa, NULL) == -1)
+        die("sigaction");
+}
 
-    // boolean variable to keep track of whether we’re currently inside a multi-line comment (this variable isn’t used for single-line comments).
-    // we initialize in_comment to true if the previous row has an unclosed multi-line comment. If that’s the case, then the current row will start out being highlighted as a multi-line comment.
-    int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
+/*** background work ***/
 
-    int i = 0;
-    while (i < row->rsize)
+/// @brief Wait up to the read timeout for the terminal or for background work, and do that work when it is ready.
+/// Returns 1 when a key is ready to be read.
+int editorBackgroundWait()
+{
+    struct pollfd fds[4 + ZEN_REMOTE_CLIENTS];
+    int nfds = 0;
+    int out = -1, in = -1, load = -1;
+    fds[nfds++] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+    if (E->pipe.pid)
     {
-        char c = row->render[i];
-
-        // 'prev_hl' is set to the highlight type of the previous character.
-        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
-
-        if (scs_len && !in_string && !in_comment)
-        {
-            if (!strncmp(&row->render[i], scs, scs_len))
-            {
-                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
-                break;
-            }
-        }
-
-        if (mcs_len && mce_len && !in_string)
-        {
-            if (in_comment)
-            {
-                row->hl[i] = HL_MLCOMMENT;
-                // If comment ends
-                if (!strncmp(&row->render[i], mce, mce_len))
-                {
-                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-                    i += mce_len;
-                    in_comment = 0;
-                    prev_sep = 1;
-                    continue;
-                }
-                else
-                {
-                    i++;
-                    continue;
-                }
-            }
-            else if (!strncmp(&row->render[i], mcs, mcs_len))
-            {
-                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
-                i += mcs_len;
-                in_comment = 1;
-                continue;
-            }
-        }
-
-        if (E.syntax->flags & HL_HIGHLIGHT_STRINGS)
-        {
-            if (in_string)
-            {
-                row->hl[i] = HL_STRING;
-
-                if (c == '\\' && i + 1 < row->rsize)
-                {
-                    row->hl[i + 1] = HL_STRING;
-                    i += 2;
-                    continue;
-                }
-
-                if (c == in_string)
-                    in_string = 0;
-
-                i++;
-                prev_sep = 1;
-                continue;
-            }
-            else
-            {
-                if (c == '"' || c == '\'')
-                {
-                    in_string = c;
-                    row->hl[i] = HL_STRING;
-
-                    i++;
-                    continue;
-                }
-            }
-        }
-
-        if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS)
-        {
-            // To highlight a digit with HL_NUMBER, we require the previous character to either be a separator, or to also be highlighted with HL_NUMBER.
-            if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER))
-            {
-                // Increment i to “consume” that character, set prev_sep to 0 to indicate we are in the middle of highlighting something,
-                // and then continue the loop.
-                row->hl[i] = HL_NUMBER;
-                i++;
-                prev_sep = 0;
-                continue;
-            }
-        }
-
-        if (prev_sep)
+        out = nfds;
+        fds[nfds++] = (struct pollfd){E->pipe.outfd, POLLIN, 0};
+        if (E->pipe.infd != -1)
         {
-            int j;
-            for (j = 0; keywords[j]; j++)
-            {
-                int klen = strlen(keywords[j]);
-                int kw2 = keywords[j][klen - 1] == '|';
-                if (kw2)
-                    klen--;
-
-                if (!strncmp(&row->render[i], keywords[j], klen) && is_separator(row->render[i + klen]))
-                {
-                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-                    i += klen;
-                    break;
-                }
-            }
-            if (keywords[j] != NULL)
-            {
-                prev_sep = 0;
-                continue;
-            }
+            in = nfds;
+            fds[nfds++] = (struct pollfd){E->pipe.infd, POLLOUT, 0};
         }
-
-        prev_sep = is_separator(c);
-        i++;
     }
-    int changed = (row->hl_open_comment != in_comment);
-    row->hl_open_comment = in_comment; // set the value of the current row’s hl_open_comment to whatever state in_comment got left in after processing the entire row.
+    if (E->load.active)
+    {
+        load = nfds;
+        fds[nfds++] = (struct pollfd){E->load.notify[0], POLLIN, 0};
+    }
+    int remote = nfds;
+    nfds += editorRemotePending(&fds[remote]);
 
-    // updating the syntax of the next lines in the file
-    if (changed && row->idx + 1 < E.numrows)
+    int n = poll(fds, nfds, 100);
+    if (n == -1)
     {
-        editorUpdateSyntax(&E.row[row->idx + 1]);
+        if (errno != EINTR)
+            die("poll");
+        // A signal, usually SIGWINCH in a burst of them: the resize is taken in once things calm down, not per signal.
+        return 0;
+    }
+    if (n == 0)
+    {
+        editorIdle();
+        return 0;
     }
-}
 
-int editorSyntaxToColor(int hl)
-{
-    switch (hl)
+    if (out != -1)
+        editorPipeService(in != -1 ? fds[in].revents : 0, fds[out].revents);
+    if (load != -1 && fds[load].revents)
+        editorLoadService();
+    editorRemoteSent(&fds[remote], nfds - remote);
+    if (out == -1 && load == -1)
+        return fds[0].revents != 0;
+
+    // Show progress at most every 100ms, not for every chunk of data.
+    static struct timespec drawn;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!(E->pipe.pid || E->load.active) || (now.tv_sec - drawn.tv_sec) * 1000 + (now.tv_nsec - drawn.tv_nsec) / 1000000 >= 100)
     {
-    case HL_MLCOMMENT:
-    case HL_COMMENT:
-        return 36;
-    case HL_KEYWORD1:
-        return 33;
-    case HL_KEYWORD2:
-        return 32;
-    case HL_STRING:
-        return 35;
-    case HL_NUMBER:
-        return 31;
-    case HL_MATCH:
-        return 34;
-    default:
-        return 37;
+        drawn = now;
+        // Work that never lets poll() time out still takes in a pending resize, at most once per progress frame.
+        if (zenTerminal.resize_pending)
+            editorHandleResize();
+        editorRefreshScreen();
     }
+    return fds[0].revents != 0;
 }
 
-/// @brief Function that tries to match the current filename to one of the filematch fields in the HLDB. If one matches, it’ll set E.syntax to that filetype.
-void editorSelectSyntaxHighlight()
+/// @brief While a filter command runs or a file loads, rows must stay where they are: only movement and Esc (abort) are allowed.
+/// Searching is allowed while a file loads, it only ever has rows appended.
+int editorBackgroundKeypress(int c)
 {
-    E.syntax = NULL;
-
-    if (E.filename == NULL)
-        return;
-
-    // strrchr() returns a pointer to the last occurrence of a character in a string
-    char *ext = strrchr(E.filename, '.');
-
-    for (unsigned int j = 0; j < HLDB_ENTRIES; j++)
+    switch (c)
     {
-        struct editorSyntax *s = &HLDB[j];
-        unsigned int i = 0;
-        while (s->filematch[i])
-        {
-            int is_ext = (s->filematch[i][0] == '.');
-
-            if ((is_ext && ext && !strcmp(ext, s->filematch[i])) || (!is_ext && strstr(E.filename, s->filematch[i])))
-            {
-                E.syntax = s;
-
-                int filerow;
-                for (filerow = 0; filerow < E.numrows; filerow++)
-                {
-                    editorUpdateSyntax(&E.row[filerow]);
-                }
-
-                return;
-            }
-            i++;
-        }
+    case CTRL_KEY('f'):
+        if (!E->pipe.pid)
+            return 0;
+        break;
+    case ARROW_UP:
+    case ARROW_DOWN:
+    case ARROW_LEFT:
+    case ARROW_RIGHT:
+    case PAGE_UP:
+    case PAGE_DOWN:
+    case HOME_KEY:
+    case END_KEY:
+        return 0;
+    case '\x1b':
+        if (E->pipe.pid)
+            editorPipeFinish(1);
+        if (E->load.active)
+            editorLoadFinish(1);
+        return 1;
     }
+    editorSetStatusMessage(E->pipe.pid ? "Filtering... (Esc to abort)" : "Loading... (Esc to stop)");
+    return 1;
 }
 
-/*** row operations ***/
+/*** hex view ***/
 
-/// @brief Converts a chars index into a render index.
-int editorRowCxToRx(erow *row, int cx)
+/// @brief Encode 16 bytes as 32 lowercase hex digits in 'hex', and as printable characters (or '.') in 'ascii'.
+void editorHexEncode16(const unsigned char *src, char *hex, char *ascii)
 {
-    int rx = 0;
-    int j;
-
-    for (j = 0; j < cx; j++)
+#ifdef __SSE2__
+    __m128i v = _mm_loadu_si128((const __m128i *)src);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    __m128i lo = _mm_and_si128(v, mask);
+
+    // Nibble n becomes '0' + n, plus 39 more when n > 9 to land on 'a'..'f'.
+    __m128i nine = _mm_set1_epi8(9), zero = _mm_set1_epi8('0'), letters = _mm_set1_epi8(39);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letters));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letters));
+    _mm_storeu_si128((__m128i *)hex, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i *)(hex + 16), _mm_unpackhi_epi8(hi, lo));
+
+    // Bytes outside 0x20..0x7e (including the ones >= 0x80, negative as signed chars) show as '.'.
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+    __m128i shown = _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+    _mm_storeu_si128((__m128i *)ascii, shown);
+#else
+    static const char digits[] = "0123456789abcdef";
+    for (int j = 0; j < 16; j++)
     {
-        if (row->chars[j] == '\t')
-        {
-            /*
-                For each character, if it’s a tab we use rx % ZEN_TAB_STOP to find out how many columns we are to the right of the last tab stop,
-                and then subtract that from ZEN_TAB_STOP - 1 to find out how many columns we are to the left of the next tab stop.
-                We add that amount to rx to get just to the left of the next tab stop, and then the unconditional rx++ statement gets us right on the next tab stop.
-            */
-            rx += (ZEN_TAB_STOP - 1) - (rx % ZEN_TAB_STOP);
-        }
-        rx++;
+        hex[2 * j] = digits[src[j] >> 4];
+        hex[2 * j + 1] = digits[src[j] & 0x0f];
+        ascii[j] = (src[j] >= 0x20 && src[j] < 0x7f) ? src[j] : '.';
     }
-
-    return rx;
+#endif
 }
 
-int editorRowRxToCx(erow *row, int rx)
+/// @brief Screen column of the hex digits of byte 'i' of a row: after the offset column, with an extra space in the middle.
+int editorHexColumn(int i)
 {
-    int cur_rx = 0;
-    int cx;
-    for (cx = 0; cx < row->size; cx++)
-    {
-        if (row->chars[cx] == '\t')
-            cur_rx += (ZEN_TAB_STOP - 1) - (cur_rx % ZEN_TAB_STOP);
-        cur_rx++;
-        if (cur_rx > rx)
-            return cx;
-    }
-    return cx;
+    return 10 + 3 * i + (i >= 8);
 }
 
-/// @brief Uses the chars string of an erow to fill in the contents of the render string.
-/// @param row
-void editorUpdateRow(erow *row)
+/// @brief Draw the rows of the hex view: offset, 16 bytes in hex, and the same bytes as text.
+void editorHexDrawRows(struct abuf *ab)
 {
-    // Count number of tabs used in line as we will render spaces instead of tabs.
-    // Because tabs just shift the cursor.
-    int tabs = 0;
-    int j;
-    for (j = 0; j < row->size; j++)
+    struct editorHex *h = E->hex;
+    char line[128];
+    for (int y = 0; y < E->screenrows; y++)
     {
-        if (row->chars[j] == '\t')
-            tabs++;
-    }
-
-    // Allocate memory to render.
-    free(row->render);
-    row->render = malloc(row->size + tabs * (ZEN_TAB_STOP - 1) + 1);
-    int idx = 0;
-
-    for (j = 0; j < row->size; j++)
-    {
-        // If we encounter tab
-        if (row->chars[j] == '\t')
+        size_t off = (h->top + y) * ZEN_HEX_STRIDE;
+        if (off >= h->size && !(off == 0 && y == 0))
         {
-            // Maximum number of characters needed for each tab is ZEN_TAB_STOP.
-            row->render[idx++] = ' ';
-            while (idx % ZEN_TAB_STOP != 0)
-                row->render[idx++] = ' ';
+            abAppend(ab, "~\x1b[K\r\n", 6);
+            continue;
         }
-        else
-        {
-            row->render[idx++] = row->chars[j];
-        }
-    }
-    row->render[idx] = '\0';
-    row->rsize = idx;
 
-    editorUpdateSyntax(row);
-}
-
-/// @brief Allocate space for a new erow, and then copy the given string to a new erow at the end of the E.row array. Insert a row at the index specified by the new at argument.
-void editorInsertRow(int at, char *s, size_t len)
-{
-    if (at < 0 || at > E.numrows)
-        return;
-
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-    // update the idx of each row whenever a row is inserted into the file.
-    for (int j = at + 1; j <= E.numrows; j++)
-    {
-        E.row[j].idx++;
+        int n = h->size - off < ZEN_HEX_STRIDE ? h->size - off : ZEN_HEX_STRIDE;
+        unsigned char bytes[ZEN_HEX_STRIDE] = {0};
+        memcpy(bytes, &h->data[off], n);
+        char hex[32], ascii[16];
+        editorHexEncode16(bytes, hex, ascii);
+
+        int len = snprintf(line, sizeof(line), "%08zx  ", off);
+        memset(&line[len], ' ', editorHexColumn(ZEN_HEX_STRIDE) - len);
+        for (int i = 0; i < n; i++)
+            memcpy(&line[editorHexColumn(i)], &hex[2 * i], 2);
+        len = editorHexColumn(ZEN_HEX_STRIDE);
+        line[len++] = ' ';
+        line[len++] = '|';
+        memcpy(&line[len], ascii, n);
+        len += n;
+        line[len++] = '|';
+
+        if (len > E->screencols)
+            len = E->screencols;
+        abAppend(ab, line, len);
+        abAppend(ab, "\x1b[K\r\n", 5);
     }
-
-    E.row[at].idx = at;
-
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
-
-    E.row[at].rsize = 0;
-    E.row[at].render = NULL;
-    E.row[at].hl = NULL;
-    E.row[at].hl_open_comment = 0;
-    editorUpdateRow(&E.row[at]);
-
-    E.numrows++;
-    E.dirty++;
 }
 
-/// @brief Freeing the memory owned by the erow.
-void editorFreeRow(erow *row)
+/// @brief Keep the cursor's row on screen.
+void editorHexScroll()
 {
-    free(row->render);
-    free(row->chars);
+    struct editorHex *h = E->hex;
+    size_t row = h->cursor / ZEN_HEX_STRIDE;
+    if (row < h->top)
+        h->top = row;
+    if (row >= h->top + E->screenrows)
+        h->top = row - E->screenrows + 1;
 }
 
-void editorDelRow(int at)
+/// @brief Handle a key in the hex view: movement, and hex digits overwriting the nibble under the cursor.
+/// Returns 0 for the keys the normal handler takes care of (save, quit, commands).
+int editorHexKeypress(int c)
 {
-    if (at < 0 || at >= E.numrows)
-        return;
+    struct editorHex *h = E->hex;
+    size_t page = (size_t)E->screenrows * ZEN_HEX_STRIDE;
+    size_t last = h->size ? h->size - 1 : 0;
 
-    editorFreeRow(&E.row[at]);
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-    // update the idx of each row whenever a row is removed from the file.
-    for (int j = at; j < E.numrows - 1; j++)
+    switch (c)
     {
-        E.row[j].idx--;
+    case CTRL_KEY('q'):
+    case CTRL_KEY('s'):
+    case CTRL_KEY('p'):
+    case CTRL_KEY('l'):
+        return 0;
+    case ARROW_LEFT:
+        if (h->low)
+            h->low = 0;
+        else if (h->cursor > 0)
+            h->cursor--, h->low = 1;
+        return 1;
+    case ARROW_RIGHT:
+        if (!h->low)
+            h->low = 1;
+        else if (h->cursor < last)
+            h->cursor++, h->low = 0;
+        return 1;
+    case ARROW_UP:
+        if (h->cursor >= ZEN_HEX_STRIDE)
+            h->cursor -= ZEN_HEX_STRIDE;
+        return 1;
+    case ARROW_DOWN:
+        if (h->cursor + ZEN_HEX_STRIDE <= last)
+            h->cursor += ZEN_HEX_STRIDE;
+        return 1;
+    case PAGE_UP:
+        h->cursor = h->cursor > page ? h->cursor - page : h->cursor % ZEN_HEX_STRIDE;
+        return 1;
+    case PAGE_DOWN:
+        h->cursor = h->cursor + page <= last ? h->cursor + page : last;
+        return 1;
+    case HOME_KEY:
+        h->cursor -= h->cursor % ZEN_HEX_STRIDE;
+        h->low = 0;
+        return 1;
+    case END_KEY:
+        h->cursor = h->cursor - h->cursor % ZEN_HEX_STRIDE + ZEN_HEX_STRIDE - 1;
+        if (h->cursor > last)
+            h->cursor = last;
+        h->low = 1;
+        return 1;
     }
 
-    E.numrows--;
-    E.dirty++;
-}
-
-/// @brief Append a string to an editor row.
-/// @param row Row to which the string needs to be appended.
-/// @param s String to append.
-/// @param len Size of the string to append.
-void editorRowAppendString(erow *row, char *s, size_t len)
-{
-    // The row’s new size is row->size + len + 1 (including the null byte).
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
-
-    row->size += len;
-
-    row->chars[row->size] = '\0';
-
-    editorUpdateRow(row);
-    E.dirty++;
-}
-
-void editorRowInsertChar(erow *row, int at, int c)
-{
-    if (at < 0 || at > row->size)
-        at = row->size;
-
-    row->chars = realloc(row->chars, row->size + 2);
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-
-    row->size++;
-
-    row->chars[at] = c;
-    editorUpdateRow(row);
-
-    E.dirty++;
-}
-
-void editorRowDelChar(erow *row, int at)
-{
-    if (at < 0 || at >= row->size)
-        return;
-
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-
-    row->size--;
-
-    editorUpdateRow(row);
-
-    E.dirty++;
+    if (!isxdigit(c) || h->size == 0)
+        return 1;
+
+    int v = isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+    unsigned char *b = &h->data[h->cursor];
+    *b = h->low ? (*b & 0xf0) | v : (*b & 0x0f) | (v << 4);
+    if (h->cursor < h->dirty_lo)
+        h->dirty_lo = h->cursor;
+    if (h->cursor + 1 > h->dirty_hi)
+        h->dirty_hi = h->cursor + 1;
+    E->dirty++;
+    editorHexKeypress(ARROW_RIGHT);
+    return 1;
 }
 
-/*** editor operations ***/
+/*** output ***/
 
-void editorInsertChar(int c)
+void editorScroll()
 {
-    if (E.cy == E.numrows)
+    E->rx = 0;
+    if (E->cy < E->numrows)
     {
-        editorInsertRow(E.numrows, "", 0);
+        E->rx = editorRowCxToRx(&E->row[E->cy], E->cx);
     }
-    editorRowInsertChar(&E.row[E.cy], E.cx, c); // Insert the character at the cursor position.
-    E.cx++;
-}
 
-void editorInsertNewline()
-{
-    // If we’re at the beginning of a line, all we have to do is insert a new blank row before the line we’re on.
-    if (E.cx == 0)
-    {
-        editorInsertRow(E.cy, "", 0);
-    }
-    // Otherwise, we have to split the line we’re on into two rows.
-    else
+    // With soft wrap on, scroll by visual lines and never horizontally.
+    if (E->wrap)
     {
-        // First we call editorInsertRow() and pass it the characters on the current row that are to the right of the cursor.
-        erow *row = &E.row[E.cy];
-        editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-
-        row = &E.row[E.cy];
-
-        // Then we truncate the current row’s contents by setting its size to the position of the cursor, and we call editorUpdateRow() on the truncated row.
-        row->size = E.cx;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(row);
-    }
-    E.cy++;
-    E.cx = 0;
-}
-
-void editorDelChar()
-{
-    if (E.cy == E.numrows)
-        return;
-
-    if (E.cx == 0 && E.cy == 0)
+        // Every row that can share the screen with the cursor is within a screen's worth of rows of it. Laying those out
+        // first makes the visual lines below exact.
+        int lo = E->cy - E->screenrows, hi = E->cy + E->screenrows;
+        for (int j = lo > 0 ? lo : 0; j < hi && j < E->numrows; j++)
+            editorRowWraps(j);
+
+        int vline = editorCursorVline();
+        if (vline < E->rowoff)
+            E->rowoff = vline;
+        if (vline >= E->rowoff + E->screenrows)
+            E->rowoff = vline - E->screenrows + 1;
+        E->coloff = 0;
         return;
+    }
 
-    erow *row = &E.row[E.cy];
-    if (E.cx > 0)
+    // Vertical Scroll
+    //  if the cursor is above the visible window, and if so, scroll up to where the cursor is.
+    if (E->cy < E->rowoff)
     {
-        editorRowDelChar(row, E.cx - 1);
-        E.cx--;
+        E->rowoff = E->cy;
     }
-    // If cursor at start of the row, append the rest of the string in row in the previos row.
-    else
+    // if the cursor is past the bottom of the visible window, and contains slightly more complicated arithmetic because E->rowoff refers to what’s at the top of the screen,
+    // and we have to get E->screenrows involved to talk about what’s at the bottom of the screen.
+    if (E->cy >= E->rowoff + E->screenrows)
     {
-        E.cx = E.row[E.cy - 1].size;
-        editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
-        editorDelRow(E.cy); // delete the row that E.cy
-        E.cy--;
+        E->rowoff = E->cy - E->screenrows + 1;
     }
-}
-
-/*** file i/o ***/
 
-/// @brief Converts our array of erow structs into a single string that is ready to be written out to a file.
-char *editorRowsToString(int *buflen)
-{
-    // Add up the lengths of each row of text, adding 1 to each one for the newline character that will be added to the end of each line.
-    int totlen = 0;
-    int j;
-    for (j = 0; j < E.numrows; j++)
+    // Horizontal Scroll
+    if (E->rx < E->coloff)
     {
-        totlen += E.row[j].size + 1;
+        E->coloff = E->rx;
     }
-    *buflen = totlen;
-
-    // Create and copy the contents to the buffer.
-    char *buf = malloc(totlen);
-    char *p = buf; // p pointer for adding the newline character.
-    for (j = 0; j < E.numrows; j++)
+    if (E->rx >= E->coloff + editorTextCols())
     {
-        memcpy(p, E.row[j].chars, E.row[j].size);
-        p += E.row[j].size;
-        *p = '\n';
-        p++;
+        E->coloff = E->rx - editorTextCols() + 1;
     }
-    return buf;
 }
 
-/// @brief Opening and Reading a file from disk
-void editorOpen(char *filename)
+/// @brief Draw 'len' render characters of a row starting at render index 'start', with syntax colors.
+/// Render indexes [sel1, sel2) are selected and drawn in inverse video.
+void editorDrawRowSegment(struct abuf *ab, erow *row, int start, int len, int sel1, int sel2)
 {
-    free(E.filename);
-    E.filename = strdup(filename);
-
-    editorSelectSyntaxHighlight();
-
-    FILE *fp = fopen(filename, "r");
-    if (!fp)
-        die("fopen");
+    char *c = &row->render[start];
+    unsigned char *hl = &row->hl[start];
+    int current_color = -1;
+    int inverse = 0;
 
-    char *line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
-
-    /*
-        getline() is useful for reading lines from a file when we don’t know how much memory to allocate for each line.
-        It takes care of memory management for you. First, we pass it a null line pointer and a linecap (line capacity) of 0.
-        That makes it allocate new memory for the next line it reads, and set line to point to the memory, and set linecap to let you know how much memory it allocated.
-        Its return value is the length of the line it read, or -1 if it’s at the end of the file and there are no more lines to read.
-    */
-    while ((linelen = getline(&line, &linecap, fp)) != -1)
+    int j;
+    for (j = 0; j < len; j++)
     {
-        while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
+        int selected = start + j >= sel1 && start + j < sel2;
+        if (selected != inverse)
         {
-            linelen--;
+            abAppend(ab, selected ? "\x1b[7m" : "\x1b[27m", selected ? 4 : 5);
+            inverse = selected;
         }
-        editorInsertRow(E.numrows, line, linelen);
-    }
-    free(line);
-    fclose(fp);
-
-    E.dirty = 0;
-}
 
-void editorSave()
-{
-    if (E.filename == NULL)
-    {
-        E.filename = editorPrompt("Save as: %s (ESC to cancel)", NULL);
-        if (E.filename == NULL)
+        if (iscntrl(c[j]))
         {
-            editorSetStatusMessage("Save aborted");
-            return;
+            /*
+                Using iscntrl() to check if the current character is a control character. If so, we translate it into a printable character by adding its value to '@'
+                (in ASCII, the capital letters of the alphabet come after the @ character), or using the '?' character if it’s not in the alphabetic range.
+            */
+            char sym = (c[j] <= 26) ? '@' + c[j] : '?';
+            // Print using inverted colors
+            abAppend(ab, "\x1b[7m", 4);
+            abAppend(ab, &sym, 1);
+            abAppend(ab, "\x1b[m", 3);
+
+            // Unfortunately, <esc>[m turns off all text formatting, including colors. So let’s print the escape sequence for the current color afterwards.
+            if (current_color != -1)
+            {
+                char buf[16];
+                int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
+                abAppend(ab, buf, clen);
+            }
+            if (inverse)
+                abAppend(ab, "\x1b[7m", 4);
         }
-        editorSelectSyntaxHighlight();
-    }
-
-    // Get string of every row in the file.
-    int len;
-    char *buf = editorRowsToString(&len);
-
-    // Open and write to the file.
-    int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-
-    if (fd != -1)
-    {
-        if (ftruncate(fd, len) != -1) // Sets the file’s size to the specified length.
+        else if (hl[j] == HL_NORMAL)
         {
-            if (write(fd, buf, len) == len)
+            if (current_color != -1)
             {
-                close(fd);
-                free(buf);
-                E.dirty = 0;
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
+                abAppend(ab, "\x1b[39m", 5);
+                current_color = -1;
             }
+            abAppend(ab, &c[j], 1);
+        }
+        else
+        {
+            int color = editorSyntaxToColor(hl[j]);
+            if (color != current_color)
+            {
+                current_color = color;
+                char buf[16];
+                int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
+                abAppend(ab, buf, clen);
+            }
+            abAppend(ab, &c[j], 1);
         }
-        close(fd);
     }
-    free(buf);
-    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    abAppend(ab, inverse ? "\x1b[27;39m" : "\x1b[39m", inverse ? 8 : 5);
 }
 
-/*** find ***/
-
-void editorFindCallback(char *query, int key)
+void editorDrawRows(struct abuf *ab)
 {
-    /*
-        'last_match' will contain the index of the row that the last match was on, or -1 if there was no last match.
-        'direction' will store the direction of the search: 1 for searching forward, and -1 for searching backward.
-    */
-    static int last_match = -1;
-    static int direction = 1;
-
-    static int saved_hl_line;
-    static char *saved_hl = NULL;
-    if (saved_hl)
-    {
-        memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-        free(saved_hl);
-        saved_hl = NULL;
-    }
-
-    if (key == '\r' || key == '\x1b')
-    {
-        last_match = -1;
-        direction = 1;
-        return;
-    }
-    else if (key == ARROW_RIGHT || key == ARROW_DOWN)
-    {
-        direction = 1;
-    }
-    else if (key == ARROW_LEFT || key == ARROW_UP)
-    {
-        direction = -1;
-    }
-    else
-    {
-        last_match = -1;
-        direction = 1;
-    }
-
-    if (last_match == -1)
-        direction = 1;
-
-    // 'current' is the index of the current row we are searching. We start on the last_match row.
-    int current = last_match;
-
-    int i;
-    for (i = 0; i < E.numrows; i++)
-    {
-        // If there was a last match, it starts on the line after (or before, if we’re searching backwards).
-        // If there wasn’t a last match, it starts at the top of the file and searches in the forward direction to find the first match.
-        current += direction;
-
-        // Causes current to go from the end of the file back to the beginning of the file, or vice versa, to allow a search to “wrap around” the end of a file and continue from the top (or bottom).
-        if (current == -1)
-            current = E.numrows - 1;
-        else if (current == E.numrows)
-            current = 0;
-
-        // The row to search.
-        erow *row = &E.row[current];
-
-        // check if query is a substring of the current row. It returns NULL if there is no match, otherwise it returns a pointer to the matching substring.
-        char *match = strstr(row->render, query);
-
-        if (match)
-        {
-            // When we find a match, we set last_match to current, so that if the user presses the arrow keys, we’ll start the next search from that point.
-            last_match = current;
-            E.cy = current;
-            E.cx = editorRowRxToCx(row, match - row->render);
-            E.rowoff = E.numrows;
-
-            saved_hl_line = current;
-            saved_hl = malloc(row->rsize);
-            memcpy(saved_hl, row->hl, row->rsize);
-
-            // match - row->render is the index into render of the match, so we use that as our index into hl.
-            memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
-            break;
-        }
-    }
-}
-
-void editorFind()
-{
-    int saved_cx = E.cx;
-    int saved_cy = E.cy;
-    int saved_coloff = E.coloff;
-    int saved_rowoff = E.rowoff;
-    char *query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)", editorFindCallback);
-    if (query)
-    {
-        free(query);
-    }
-    // When the user presses Escape to cancel a search, we want the cursor to go back to where it was when they started the search.
-    else
-    {
-        E.cx = saved_cx;
-        E.cy = saved_cy;
-        E.coloff = saved_coloff;
-        E.rowoff = saved_rowoff;
-    }
-}
-
-/*** append buffer ***/
-
-// Create our own dynamic string type that supports one operation: appending.
-struct abuf
-{
-    char *b;
-    int len;
-};
-
-#define ABUF_INIT {NULL, 0}
-
-/// @brief To append a string s to an abuf
-/// @param ab Buffer to append the string onto.
-/// @param s The String to append.
-/// @param len Length of the new string to append in buffer.
-void abAppend(struct abuf *ab, const char *s, int len)
-{
-    char *new = realloc(ab->b, ab->len + len); // Create a new buffer of size (afub.len + len) and contents of abuf
-    if (new == NULL)
-        return;
-    memcpy(&new[ab->len], s, len); // Copy contents of s to to new[ab.len].
-    ab->b = new;                   // Make abuf point the new buffer created.
-    ab->len += len;
-}
-
-/// @brief Deallocates the dynamic memory used by an abuf.
-void abFree(struct abuf *ab)
-{
-    free(ab->b);
-}
-
-/*** output ***/
-
-void editorScroll()
-{
-    E.rx = 0;
-    if (E.cy < E.numrows)
-    {
-        E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
-    }
-
-    // Vertical Scroll
-    //  if the cursor is above the visible window, and if so, scroll up to where the cursor is.
-    if (E.cy < E.rowoff)
+    int cols = editorTextCols();
+
+    // With soft wrap on, E->rowoff is a visual line: find the file row and wrapped line it falls on once, then walk forward.
+    int filerow = E->rowoff;
+    int sub = 0;
+    if (E->wrap)
+        filerow = editorVlineToRow(E->rowoff, &sub);
+
+    // Only the first line number on screen is formatted, the following ones are produced by incrementing it.
+    char lineno[16];
+    char blank[16];
+    if (E->gutter)
     {
-        E.rowoff = E.cy;
+        editorFormatLineNumber(lineno, filerow + 1);
+        memset(blank, ' ', E->gutter);
     }
-    // if the cursor is past the bottom of the visible window, and contains slightly more complicated arithmetic because E.rowoff refers to what’s at the top of the screen,
-    // and we have to get E.screenrows involved to talk about what’s at the bottom of the screen.
-    if (E.cy >= E.rowoff + E.screenrows)
-    {
-        E.rowoff = E.cy - E.screenrows + 1;
-    }
-
-    // Horizontal Scroll
-    if (E.rx < E.coloff)
-    {
-        E.coloff = E.rx;
-    }
-    if (E.rx >= E.coloff + E.screencols)
-    {
-        E.coloff = E.rx - E.screencols + 1;
-    }
-}
 
-void editorDrawRows(struct abuf *ab)
-{
     int y;
-    for (y = 0; y < E.screenrows; y++)
+    for (y = 0; y < E->screenrows; y++)
     {
-        int filerow = y + E.rowoff;
-        if (filerow >= E.numrows)
+        if (filerow >= E->numrows)
         {
-            if (E.numrows == 0 && y == E.screenrows / 3)
+            if (E->numrows == 0 && y == E->screenrows / 3)
             {
                 char welcome[80];
                 int welcomelen = snprintf(welcome, sizeof(welcome), "🤖 Zen text editor -- version %s -- Made by Harsh Kishorani! 🤖", ZEN_VERSION);
-                if (welcomelen > E.screencols)
-                    welcomelen = E.screencols;
+                if (welcomelen > E->screencols)
+                    welcomelen = E->screencols;
 
-                int padding = (E.screencols - welcomelen) / 2;
+                int padding = (E->screencols - welcomelen) / 2;
                 if (padding)
                 {
                     abAppend(ab, "~", 1);
@@ -1148,62 +801,24 @@ void editorDrawRows(struct abuf *ab)
         }
         else
         {
-            int len = E.row[filerow].rsize - E.coloff;
+            erow *row = &E->row[filerow];
+            int start = E->wrap ? sub * cols : E->coloff;
+
+            editorRowHighlight(row);
+
+            // Wrapped continuation lines get an empty gutter.
+            if (E->gutter)
+                abAppend(ab, sub == 0 ? lineno : blank, E->gutter);
+
+            int len = row->rsize - start;
             if (len < 0)
                 len = 0;
-            if (len > E.screencols)
-                len = E.screencols;
+            if (len > cols)
+                len = cols;
 
-            char *c = &E.row[filerow].render[E.coloff];
-            unsigned char *hl = &E.row[filerow].hl[E.coloff];
-            int current_color = -1;
-
-            int j;
-            for (j = 0; j < len; j++)
-            {
-                if (iscntrl(c[j]))
-                {
-                    /*
-                        Using iscntrl() to check if the current character is a control character. If so, we translate it into a printable character by adding its value to '@'
-                        (in ASCII, the capital letters of the alphabet come after the @ character), or using the '?' character if it’s not in the alphabetic range.
-                    */
-                    char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-                    // Print using inverted colors
-                    abAppend(ab, "\x1b[7m", 4);
-                    abAppend(ab, &sym, 1);
-                    abAppend(ab, "\x1b[m", 3);
-
-                    // Unfortunately, <esc>[m turns off all text formatting, including colors. So let’s print the escape sequence for the current color afterwards.
-                    if (current_color != -1)
-                    {
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-                        abAppend(ab, buf, clen);
-                    }
-                }
-                else if (hl[j] == HL_NORMAL)
-                {
-                    if (current_color != -1)
-                    {
-                        abAppend(ab, "\x1b[39m", 5);
-                        current_color = -1;
-                    }
-                    abAppend(ab, &c[j], 1);
-                }
-                else
-                {
-                    int color = editorSyntaxToColor(hl[j]);
-                    if (color != current_color)
-                    {
-                        current_color = color;
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-                        abAppend(ab, buf, clen);
-                    }
-                    abAppend(ab, &c[j], 1);
-                }
-            }
-            abAppend(ab, "\x1b[39m", 5);
+            int sel1 = 0, sel2 = 0;
+            editorSelectionRender(filerow, &sel1, &sel2);
+            editorDrawRowSegment(ab, row, start, len, sel1, sel2);
         }
 
         /*
@@ -1214,11 +829,70 @@ void editorDrawRows(struct abuf *ab)
         abAppend(ab, "\x1b[K", 3);
 
         abAppend(ab, "\r\n", 2);
+
+        // Advance to the next visual line.
+        if (E->wrap && filerow < E->numrows && ++sub < editorRowWraps(filerow))
+            continue;
+        filerow++;
+        sub = 0;
+        if (E->gutter)
+            editorIncrementLineNumber(lineno);
     }
 }
 
 void editorDrawStatusBar(struct abuf *ab)
 {
+    struct statusFields f;
+    memset(&f, 0, sizeof(f)); // Zero the padding too, the struct is compared with memcmp().
+    f.filename = E->filename;
+    f.syntax = E->syntax;
+    f.numrows = E->numrows;
+    f.modified = E->dirty != 0;
+    f.line = E->cy + 1;
+    f.col = E->cx + 1;
+    f.offset = editorCursorOffset();
+    f.total = E->totalbytes;
+    f.selection = editorSelectionSize();
+    if (E->hex)
+    {
+        f.numrows = (E->hex->size + ZEN_HEX_STRIDE - 1) / ZEN_HEX_STRIDE;
+        f.line = E->hex->cursor / ZEN_HEX_STRIDE + 1;
+        f.col = E->hex->cursor % ZEN_HEX_STRIDE + 1;
+        f.offset = E->hex->cursor;
+        f.total = E->hex->size;
+    }
+
+    // Nothing the bar shows has changed: the terminal still displays it, just step over that line.
+    if (E->statusbar_valid && !memcmp(&f, E->status, sizeof(f)))
+    {
+        abAppend(ab, "\r\n", 2);
+        return;
+    }
+    *E->status = f;
+    E->statusbar_valid = 1;
+
+    char status[80], rstatus[80];
+    int len = snprintf(status, sizeof(status), "%.20s - %d lines %s", E->filename ? E->filename : "[No Name]", f.numrows, E->dirty ? "(modified)" : "");
+
+    // Current row and column, and the cursor offset out of the file size.
+    const char *ft = E->hex ? "hex" : E->syntax ? E->syntax->filetype : "no ft";
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d:%d | %lld/%lld B", ft, f.line, f.numrows, f.col, f.offset, f.total);
+    if (f.selection >= 0 && rlen < (int)sizeof(rstatus))
+        rlen += snprintf(&rstatus[rlen], sizeof(rstatus) - rlen, " | sel %lld B", f.selection);
+    if (rlen >= (int)sizeof(rstatus))
+        rlen = sizeof(rstatus) - 1;
+
+    if (len > E->screencols)
+        len = E->screencols;
+
+    // Lay the bar out once with a memset for the padding, instead of appending it one space at a time.
+    E->statusbar = realloc(E->statusbar, E->screencols + 1);
+    memset(E->statusbar, ' ', E->screencols);
+    memcpy(E->statusbar, status, len);
+    // Display the right status at the end of the status bar if it fits.
+    if (len + rlen <= E->screencols)
+        memcpy(&E->statusbar[E->screencols - rlen], rstatus, rlen);
+
     /*
         To make the status bar stand out, we’re going to display it with inverted colors: black text on a white background.
         The escape sequence '<esc>[7m' switches to inverted colors, and '<esc>[m' switches back to normal formatting.
@@ -1226,49 +900,127 @@ void editorDrawStatusBar(struct abuf *ab)
         The m command (Select Graphic Rendition) : http://vt100.net/docs/vt100-ug/chapter3.html#SGR
     */
     abAppend(ab, "\x1b[7m", 4);
+    abAppend(ab, E->statusbar, E->screencols);
+    abAppend(ab, "\x1b[m", 3);
+    abAppend(ab, "\r\n", 2);
+}
 
-    char status[80], rstatus[80];
-    int len = snprintf(status, sizeof(status), "%.20s - %d lines %s", E.filename ? E.filename : "[No Name]", E.numrows, E.dirty ? "(modified)" : "");
+void editorDrawMessageBar(struct abuf *ab)
+{
+    abAppend(ab, "\x1b[K", 3);
+    int msglen = strlen(E->statusmsg);
+    if (msglen > E->screencols)
+        msglen = E->screencols;
+    if (msglen && time(NULL) - E->statusmsg_time < 5)
+        abAppend(ab, E->statusmsg, msglen);
+}
 
-    // Current row number.
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d", E.syntax ? E.syntax->filetype : "no ft", E.cy + 1, E.numrows);
+/// @brief Draw the timing overlay: p50, p99 and max of every stage, in the bottom right corner of the text area.
+void editorDrawPerfOverlay(struct abuf *ab)
+{
+    char lines[PERF_STAGES + 1][64];
+    double scale = editorPerfNanos();
+    snprintf(lines[0], sizeof(lines[0]), " %-10s %7s %7s %7s ", "stage", "p50", "p99", "max");
+    for (int i = 0; i < PERF_STAGES; i++)
+    {
+        struct perfHist *h = &zenPerf.stage[i];
+        char p50[16], p99[16], max[16];
+        editorPerfFormat(p50, sizeof(p50), editorPerfPercentile(h, 0.5), scale);
+        editorPerfFormat(p99, sizeof(p99), editorPerfPercentile(h, 0.99), scale);
+        editorPerfFormat(max, sizeof(max), h->max, scale);
+        snprintf(lines[i + 1], sizeof(lines[i + 1]), " %-10s %7s %7s %7s ", perfStageNames[i], p50, p99, max);
+    }
 
-    if (len > E.screencols)
-        len = E.screencols;
+    int width = strlen(lines[0]);
+    if (width > E->screencols)
+        width = E->screencols;
+    int top = E->screenrows - (PERF_STAGES + 1);
+    if (top < 0)
+        top = 0;
 
-    abAppend(ab, status, len);
+    for (int i = 0; i <= PERF_STAGES && top + i < E->screenrows; i++)
+    {
+        char pos[32];
+        int plen = snprintf(pos, sizeof(pos), "\x1b[%d;%dH\x1b[7m", top + i + 1, E->screencols - width + 1);
+        abAppend(ab, pos, plen);
+        abAppend(ab, lines[i], width);
+        abAppend(ab, "\x1b[m", 3);
+    }
+}
 
-    while (len < E.screencols)
+/// @brief Draw the document statistics as a box in the top right corner of the text area.
+void editorDrawStatsPanel(struct abuf *ab)
+{
+    char lines[5][40];
+    snprintf(lines[0], sizeof(lines[0]), " Lines:   %16d ", E->numrows);
+    snprintf(lines[1], sizeof(lines[1]), " Words:   %16lld ", E->stats.words);
+    snprintf(lines[2], sizeof(lines[2]), " Bytes:   %16lld ", E->totalbytes);
+    snprintf(lines[3], sizeof(lines[3]), " Chars:   %16lld ", E->stats.chars + E->numrows); // Newlines count as characters, like wc -m.
+    snprintf(lines[4], sizeof(lines[4]), " Longest: %16d ", editorStatsLongest());
+
+    int width = strlen(lines[0]);
+    if (width > E->screencols)
+        width = E->screencols;
+
+    for (int i = 0; i < 5 && i < E->screenrows; i++)
     {
-        // Display current row number at the end of status bar.
-        if (E.screencols - len == rlen)
-        {
-            abAppend(ab, rstatus, rlen);
-            break;
-        }
-        else
-        {
-            abAppend(ab, " ", 1);
-            len++;
-        }
+        char pos[32];
+        int plen = snprintf(pos, sizeof(pos), "\x1b[%d;%dH\x1b[7m", i + 1, E->screencols - width + 1);
+        abAppend(ab, pos, plen);
+        abAppend(ab, lines[i], width);
+        abAppend(ab, "\x1b[m", 3);
     }
-    abAppend(ab, "\x1b[m", 3);
-    abAppend(ab, "\r\n", 2);
 }
 
-void editorDrawMessageBar(struct abuf *ab)
+/// @brief Draw the extra cursors as inverse video cells over the text. Only the cursors on screen are visited.
+void editorDrawCursors(struct abuf *ab)
 {
-    abAppend(ab, "\x1b[K", 3);
-    int msglen = strlen(E.statusmsg);
-    if (msglen > E.screencols)
-        msglen = E.screencols;
-    if (msglen && time(NULL) - E.statusmsg_time < 5)
-        abAppend(ab, E.statusmsg, msglen);
+    int top = E->wrap ? editorVlineToRow(E->rowoff, NULL) : E->rowoff;
+    int lo = 0, hi = E->ncursors;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (E->cursors[mid].cy < top)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    int cols = editorTextCols();
+    for (int i = lo; i < E->ncursors && E->cursors[i].cy < E->numrows; i++)
+    {
+        erow *row = &E->row[E->cursors[i].cy];
+        int rx = editorRowCxToRx(row, E->cursors[i].cx);
+        int y = E->cursors[i].cy - E->rowoff;
+        int x = rx - E->coloff;
+        if (E->wrap)
+        {
+            y = editorRowToVline(E->cursors[i].cy) + rx / cols - E->rowoff;
+            x = rx % cols;
+        }
+        if (y >= E->screenrows)
+            break;
+        if (y < 0 || x < 0 || x >= cols)
+            continue;
+
+        char pos[48];
+        int plen = snprintf(pos, sizeof(pos), "\x1b[%d;%dH\x1b[7m%c\x1b[m", y + 1, x + E->gutter + 1,
+                            rx < row->rsize && !iscntrl(row->render[rx]) ? row->render[rx] : ' ');
+        abAppend(ab, pos, plen);
+    }
 }
 
 void editorRefreshScreen()
 {
-    editorScroll();
+    // A macro being played back renders a single frame once it is done.
+    if (zenMacro.playing)
+        return;
+    uint64_t frame = editorPerfNow();
+
+    if (E->hex)
+        editorHexScroll();
+    else
+        editorScroll();
     /*
         Intro to Escape Sequences. Consider an example : ("\x1b[2J", 4)
 
@@ -1295,38 +1047,98 @@ void editorRefreshScreen()
 
     abAppend(&ab, "\x1b[H", 3); // H Command - Reposition it at the top-left corner so that we’re ready to draw the editor interface from top to bottom.
 
-    editorDrawRows(&ab);
+    uint64_t t = editorPerfNow();
+    if (E->hex)
+        editorHexDrawRows(&ab);
+    else
+        editorDrawRows(&ab);
+    editorPerfEnd(PERF_DRAW_ROWS, t);
     editorDrawStatusBar(&ab);
     editorDrawMessageBar(&ab);
+    if (E->ncursors)
+        editorDrawCursors(&ab);
+    if (E->stats_panel)
+        editorDrawStatsPanel(&ab);
+    if (zenPerf.overlay)
+        editorDrawPerfOverlay(&ab);
+
+    int cursor_y = (E->cy - E->rowoff) + 1;
+    int cursor_x = (E->rx - E->coloff) + 1;
+    if (E->wrap)
+    {
+        cursor_y = (editorCursorVline() - E->rowoff) + 1;
+        cursor_x = (E->rx % editorTextCols()) + 1;
+    }
+    cursor_x += E->gutter;
+    if (E->hex)
+    {
+        cursor_y = E->hex->cursor / ZEN_HEX_STRIDE - E->hex->top + 1;
+        cursor_x = editorHexColumn(E->hex->cursor % ZEN_HEX_STRIDE) + E->hex->low + 1;
+    }
 
     char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1); // H- Command - Reposition the cursor to the desired location.
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", cursor_y, cursor_x); // H- Command - Reposition the cursor to the desired location.
     abAppend(&ab, buf, strlen(buf));
 
     abAppend(&ab, "\x1b[?25h", 6); // Reset the cursor (Display it back).
 
+    t = editorPerfNow();
     write(STDOUT_FILENO, ab.b, ab.len); // Write the whole buffer onto the terminal instead of using multiple write statements.
+    editorPerfEnd(PERF_WRITE, t);
     abFree(&ab);
+    editorPerfEnd(PERF_FRAME, frame);
 }
 
-void editorSetStatusMessage(const char *fmt, ...)
+/// @brief Pick up a new terminal size and repaint once.
+/*
+    A tiling window manager can send dozens of SIGWINCH while a window is dragged. The handler only sets zenTerminal.resize_pending,
+    and since every signal restarts the VTIME timeout of read(), we only get here once the storm has been quiet for 100ms,
+    so the whole storm costs one relayout and one repaint.
+*/
+void editorHandleResize()
 {
-    /*
-        The ... argument makes editorSetStatusMessage() a variadic function, meaning it can take any number of arguments.
-        C’s way of dealing with these arguments is by having you call va_start() and va_end() on a value of type va_list.
-        The last argument before the ... (in this case, fmt) must be passed to va_start(), so that the address of the next arguments is known.
-        Then, between the va_start() and va_end() calls, you would call va_arg() and pass it the type of the next argument (which you usually get from the given format string) and it would return the value of that argument.
-        In this case, we pass fmt and ap to vsnprintf() and it takes care of reading the format string and calling va_arg() to get each argument.
-    */
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap); // vsnprintf() helps us make our own printf()-style function
-    va_end(ap);
-    E.statusmsg_time = time(NULL); // set E.statusmsg_time to the current time
+    zenTerminal.resize_pending = 0;
+
+    int rows, cols;
+    if (getWindowSize(&rows, &cols) == -1)
+        return;
+    rows -= 2; // Make room for Status Bar and Status message.
+
+    if (rows == E->screenrows && cols == E->screencols)
+        return;
+
+    if (cols != E->screencols)
+    {
+        // Only the wrap layout depends on the width, render and hl do not.
+        E->screencols = cols;
+        editorInvalidateLayout();
+    }
+    E->screenrows = rows;
+    E->statusbar_valid = 0;
+
+    editorRefreshScreen();
 }
 
 /*** input ***/
 
+/// @brief Background work run from editorReadKey() whenever no key arrived within the read timeout.
+void editorIdle()
+{
+    if (zenServer.listenfd != -1 && zenServer.client != -1)
+    {
+        editorServerPollClient();
+        editorServerTurnAway();
+    }
+    if (zenTerminal.resize_pending)
+        editorHandleResize();
+    // Remote edits would move the rows a running filter command or a file being loaded is writing into, and shift rows
+    // from under the state of an open prompt (the search keeps a row's highlighting), a selection or extra cursors.
+    // Requests wait in the socket until the editor is back at its top level.
+    if (zenRemote.listenfd != -1 && !E->pipe.pid && !E->load.active && !zenTerminal.prompting && !E->sel_active && !E->ncursors)
+        editorRemotePoll();
+    editorAutosave();
+}
+
 /// @brief Displays a prompt in the status bar, and lets the user input a line of text after the prompt.
 char *editorPrompt(char *prompt, void (*callback)(char *, int))
 {
@@ -1335,6 +1147,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int))
     size_t buflen = 0;
     buf[0] = '\0';
 
+    zenTerminal.prompting++;
     while (1)
     {
         editorSetStatusMessage(prompt, buf);
@@ -1353,6 +1166,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int))
             if (callback)
                 callback(buf, c);
             free(buf);
+            zenTerminal.prompting--;
             return NULL;
         }
         // When the user presses Enter, and their input is not empty, the status message is cleared and their input is returned.
@@ -1363,6 +1177,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int))
                 editorSetStatusMessage("");
                 if (callback)
                     callback(buf, c);
+                zenTerminal.prompting--;
                 return buf;
             }
         }
@@ -1384,64 +1199,245 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int))
     }
 }
 
+/// @brief Move the cursor one visual line up or down when soft wrap is on, keeping its column within the wrapped line.
+void editorMoveCursorVisual(int key)
+{
+    int cols = editorTextCols();
+    if (E->cy < E->numrows)
+        editorRowWraps(E->cy);
+    int rx = (E->cy < E->numrows) ? editorRowCxToRx(&E->row[E->cy], E->cx) : 0;
+    int vline = editorRowToVline(E->cy) + rx / cols;
+
+    if (key == ARROW_UP)
+    {
+        if (vline == 0)
+            return;
+        vline--;
+    }
+    else
+    {
+        if (E->cy >= E->numrows)
+            return;
+        vline++;
+    }
+
+    int sub;
+    E->cy = editorVlineToRow(vline, &sub);
+    // The row may not be laid out at this width yet, see editorRowWraps().
+    if (E->cy < E->numrows && sub >= editorRowWraps(E->cy))
+        sub = E->row[E->cy].wraps - 1;
+    if (E->cy < E->numrows)
+        E->cx = editorRowRxToCx(&E->row[E->cy], sub * cols + rx % cols);
+    else
+        E->cx = 0;
+}
+
 void editorMoveCursor(int key)
 {
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    erow *row = (E->cy >= E->numrows) ? NULL : &E->row[E->cy];
+
+    if (E->wrap && (key == ARROW_UP || key == ARROW_DOWN))
+    {
+        editorMoveCursorVisual(key);
+        return;
+    }
 
     switch (key)
     {
     case ARROW_LEFT:
-        if (E.cx != 0)
+        if (E->cx != 0)
         {
-            E.cx--;
+            E->cx--;
         }
-        else if (E.cy > 0)
+        else if (E->cy > 0)
         {
-            E.cy--;
-            E.cx = E.row[E.cy].size; // Go to end char of prev line if going left out of bound.
+            E->cy--;
+            E->cx = E->row[E->cy].size; // Go to end char of prev line if going left out of bound.
         }
         break;
     case ARROW_RIGHT:
         // Only increment cursor if it's not end of the line
-        if (row && E.cx < row->size)
+        if (row && E->cx < row->size)
         {
-            E.cx++;
+            E->cx++;
         }
-        else if (row && E.cx == row->size)
+        else if (row && E->cx == row->size)
         {
-            E.cy++;
-            E.cx = 0;
+            E->cy++;
+            E->cx = 0;
         }
         break;
     case ARROW_UP:
-        if (E.cy != 0)
+        if (E->cy != 0)
         {
-            E.cy--;
+            E->cy--;
         }
         break;
     case ARROW_DOWN:
-        if (E.cy < E.numrows)
+        if (E->cy < E->numrows)
         {
-            E.cy++;
+            E->cy++;
         }
         break;
     }
 
     // Snap cursor to end of line
-    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    row = (E->cy >= E->numrows) ? NULL : &E->row[E->cy];
     int rowlen = row ? row->size : 0;
-    if (E.cx > rowlen)
+    if (E->cx > rowlen)
+    {
+        E->cx = rowlen;
+    }
+}
+
+void editorFind()
+{
+    int saved_cx = E->cx;
+    int saved_cy = E->cy;
+    int saved_coloff = E->coloff;
+    int saved_rowoff = E->rowoff;
+    char *query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)", editorFindCallback);
+    if (query)
     {
-        E.cx = rowlen;
+        free(query);
+    }
+    // When the user presses Escape to cancel a search, we want the cursor to go back to where it was when they started the search.
+    else
+    {
+        E->cx = saved_cx;
+        E->cy = saved_cy;
+        E->coloff = saved_coloff;
+        E->rowoff = saved_rowoff;
+    }
+}
+
+void editorCommandPrompt()
+{
+    char *line = editorPrompt("Command: %s (sort [-n] [-r], uniq, filter [-v] REGEX, !SHELL-COMMAND, hex, gzip)", NULL);
+    if (line == NULL)
+        return;
+    editorCommand(line);
+    free(line);
+}
+
+/// @brief Ask for the line to add cursors down to.
+void editorCursorAddLinesPrompt()
+{
+    char *input = editorPrompt("Add cursors down to line: %s (ESC to cancel)", NULL);
+    if (input == NULL)
+        return;
+    editorCursorAddLines(atoi(input) - 1);
+    free(input);
+}
+
+/// @brief Save the file, asking for a file name first if the buffer has none, or holds only part of its file.
+void editorSavePrompt()
+{
+    if (E->filename == NULL && E->hex == NULL)
+    {
+        E->filename = editorPrompt("Save as: %s (ESC to cancel)", NULL);
+        if (E->filename == NULL)
+        {
+            editorSetStatusMessage("Save aborted");
+            return;
+        }
+        editorSelectSyntaxHighlight();
+    }
+    else if (E->partial)
+    {
+        // Writing the loaded part over the file would lose the rest of it, so it goes to another file.
+        char *filename = editorPrompt("Only part of the file is loaded, save as: %s (ESC to cancel)", NULL);
+        if (filename == NULL || !strcmp(filename, E->filename))
+        {
+            editorSetStatusMessage(filename ? "Can't save! Only part of the file was loaded" : "Save aborted");
+            free(filename);
+            return;
+        }
+        free(E->filename);
+        E->filename = filename;
+        E->partial = 0;
+    }
+    editorSave();
+}
+
+/*** macros ***/
+
+void editorMacroToggleRecord()
+{
+    if (zenMacro.recording)
+    {
+        zenMacro.recording = 0;
+        zenMacro.len--; // Drop the Ctrl-R that stopped the recording.
+        editorSetStatusMessage("Macro recorded: %d keys. Ctrl-E to play it back", zenMacro.len);
+        return;
+    }
+    zenMacro.len = 0;
+    zenMacro.recording = 1;
+    editorSetStatusMessage("Recording macro... Ctrl-R to stop");
+}
+
+/// @brief Replay the macro 'times' times as a single batch: no repaint and no highlighting per key, one of each at the end.
+void editorMacroPlay(long times)
+{
+    zenMacro.playing = 1;
+    editorBatchBegin();
+    for (long t = 0; t < times && !zenServer.quit; t++)
+    {
+        zenMacro.pos = 0;
+        while (zenMacro.pos < zenMacro.len && !zenServer.quit)
+            editorProcessKeypress();
+    }
+    editorBatchEnd();
+    zenMacro.playing = 0;
+}
+
+void editorMacroPlayPrompt()
+{
+    if (zenMacro.recording)
+    {
+        editorSetStatusMessage("Cannot play a macro while recording one");
+        return;
+    }
+    if (zenMacro.len == 0)
+    {
+        editorSetStatusMessage("No macro recorded. Ctrl-R to record one");
+        return;
     }
+
+    char *count = editorPrompt("Play macro how many times: %s (ESC to cancel)", NULL);
+    if (count == NULL)
+        return;
+    long times = strtol(count, NULL, 10);
+    free(count);
+    if (times <= 0)
+        return;
+
+    editorMacroPlay(times);
+    editorSetStatusMessage("Macro played %ld times", times);
 }
 
 /// @brief Wait for a keypress, and then handle it.
 void editorProcessKeypress()
+{
+    int c = editorReadKey();
+    uint64_t t = editorPerfNow();
+    editorProcessKey(c);
+    editorPerfEnd(PERF_KEYPRESS, t);
+}
+
+void editorProcessKey(int c)
 {
     static int quit_times = ZEN_QUIT_TIMES;
 
-    int c = editorReadKey();
+    if (E->hex && editorHexKeypress(c))
+        return;
+    if ((E->pipe.pid || E->load.active) && editorBackgroundKeypress(c))
+        return;
+    if (E->ncursors && editorMultiKeypress(c))
+        return;
+    if (E->sel_active && E->sel_block && editorBlockKeypress(c))
+        return;
+
     switch (c)
     {
     // 'Enter' Key
@@ -1450,11 +1446,12 @@ void editorProcessKeypress()
         break;
 
     case CTRL_KEY('q'):
-        if (E.dirty && quit_times > 0)
+        // A server keeps the buffer loaded after the client leaves, but the file on disk may still change behind it.
+        if (E->dirty && quit_times > 0)
         {
             editorSetStatusMessage("WARNING!!! File has unsaved changes. "
-                                   "Press Ctrl-Q %d more times to quit.",
-                                   quit_times);
+                                   "Press Ctrl-Q %d more times to %s.",
+                                   quit_times, zenServer.listenfd == -1 ? "quit" : "detach");
             quit_times--;
             return;
         }
@@ -1462,26 +1459,85 @@ void editorProcessKeypress()
         write(STDOUT_FILENO, "\x1b[2J", 4);
         write(STDOUT_FILENO, "\x1b[H", 3);
 
+        if (zenServer.listenfd != -1)
+        {
+            zenServer.quit = 1;
+            break;
+        }
         exit(0);
         break;
 
     case CTRL_KEY('s'):
-        editorSave();
+        editorSavePrompt();
         break;
 
     case HOME_KEY:
-        E.cx = 0;
+        E->cx = 0;
         break;
     case END_KEY:
         // Move to the end of the line with End
-        if (E.cy < E.numrows)
-            E.cx = E.row[E.cy].size;
+        if (E->cy < E->numrows)
+            E->cx = E->row[E->cy].size;
         break;
 
     case CTRL_KEY('f'):
         editorFind();
         break;
 
+    case CTRL_KEY('w'):
+        editorToggleWrap();
+        break;
+
+    case CTRL_KEY('n'):
+        editorToggleLineNumbers();
+        break;
+
+    case CTRL_KEY('g'):
+        editorToggleStatsPanel();
+        break;
+
+    case CTRL_KEY('d'):
+        editorCursorAddNextMatch();
+        break;
+
+    case CTRL_KEY('b'):
+        editorSelectionToggle();
+        break;
+
+    case CTRL_KEY('k'):
+        editorBlockToggle();
+        break;
+
+    case CTRL_KEY('p'):
+        editorCommandPrompt();
+        break;
+
+    case CTRL_KEY('c'):
+        editorCopy();
+        break;
+
+    case CTRL_KEY('x'):
+        editorCut();
+        break;
+
+    case CTRL_KEY('v'):
+        editorPaste();
+        break;
+
+    case CTRL_KEY('t'):
+        editorCursorAddLinesPrompt();
+        break;
+
+    case CTRL_KEY('r'):
+        editorMacroToggleRecord();
+        break;
+
+    case CTRL_KEY('e'):
+        // Playing back from inside a macro would never end.
+        if (!zenMacro.playing)
+            editorMacroPlayPrompt();
+        break;
+
     case BACKSPACE:
     case CTRL_KEY('h'):
     case DEL_KEY:
@@ -1493,18 +1549,25 @@ void editorProcessKeypress()
     case PAGE_UP:
     case PAGE_DOWN:
     {
-        if (c == PAGE_UP)
+        if (E->wrap)
+        {
+            // Jump to the first or last visual line on screen, then move a screen's worth of visual lines.
+            int vline = (c == PAGE_UP) ? E->rowoff : E->rowoff + E->screenrows - 1;
+            E->cy = editorVlineToRow(vline, NULL);
+            E->cx = 0;
+        }
+        else if (c == PAGE_UP)
         {
-            E.cy = E.rowoff;
+            E->cy = E->rowoff;
         }
         else if (c == PAGE_DOWN)
         {
-            E.cy = E.rowoff + E.screenrows - 1;
-            if (E.cy > E.numrows)
-                E.cy = E.numrows;
+            E->cy = E->rowoff + E->screenrows - 1;
+            if (E->cy > E->numrows)
+                E->cy = E->numrows;
         }
 
-        int times = E.screenrows;
+        int times = E->screenrows;
         while (times--)
             editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
     }
@@ -1517,49 +1580,732 @@ void editorProcessKeypress()
         editorMoveCursor(c);
         break;
 
-    case CTRL_KEY('l'):
     case '\x1b':
+        E->sel_active = 0;
+        break;
+
+    case CTRL_KEY('l'):
         break;
 
     default:
         editorInsertChar(c);
         break;
     }
+
+    // Any other key, or a detach, starts the count of Ctrl-Q presses over.
+    quit_times = ZEN_QUIT_TIMES;
 }
 
 /*** init ***/
 
 void initEditor()
 {
-    E.cx = 0;
-    E.cy = 0;
-    E.rx = 0;
-    E.rowoff = 0;
-    E.coloff = 0;
-    E.numrows = 0;
-    E.row = NULL;
-    E.dirty = 0;
-    E.filename = NULL;
-    E.statusmsg[0] = '\0';
-    E.statusmsg_time = 0;
-    E.syntax = NULL;
-
-    if (getWindowSize(&E.screenrows, &E.screencols) == -1)
+    editorNewBuffer();
+
+    if (getWindowSize(&E->screenrows, &E->screencols) == -1)
         die("getWindowSize");
 
-    E.screenrows -= 2; // Make room for Status Bar and Status message.
+    E->screenrows -= 2; // Make room for Status Bar and Status message.
+    zenTerminal.resize_pending = 0;
+
+    installSignalHandlers();
 }
 
-int main(int argc, char *argv[])
+/*** remote control ***/
+
+/*
+    'zen --listen=PATH file' accepts connections on the Unix socket PATH. Each request is one line, and gets one response line
+    starting with "ok" or "err". Rows and columns are 1-based, columns count bytes:
+
+        insert ROW COL TEXT     insert TEXT (\n, \t, \r and \\ escapes allowed); answers with the position after it
+        delete R1 C1 R2 C2      delete from (R1, C1) up to, but not including, (R2, C2)
+        search TEXT             find TEXT after the cursor, wrapping around, and move the cursor there
+        goto ROW [COL]          move the cursor
+        save                    write the file
+        text [R1 [R2]]          answers "ok N" followed by the N rows R1..R2 (the whole file by default)
+
+    All the requests that have arrived when the editor gets to them are applied as one batch, with one highlighting pass and one
+    repaint, so a tool should write its requests in one go and read the responses afterwards. Requests are held while the user
+    is in a prompt, has a selection or has extra cursors, and run once that is over. Responses are queued and sent as the tool
+    reads them. A request line longer than ZEN_REMOTE_LINE gets "err line too long" and the tool is disconnected.
+*/
+
+/// @brief Accept connections on the remote control socket given with --listen.
+int editorRemoteListen(char *path)
 {
-    enableRawMode();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    unlink(path);
+    zenRemote.listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (zenRemote.listenfd == -1 || bind(zenRemote.listenfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(zenRemote.listenfd, 4) == -1)
+        return -1;
+    fcntl(zenRemote.listenfd, F_SETFL, O_NONBLOCK);
+    chmod(path, 0600);
+    zenRemote.path = strdup(path);
+    signal(SIGPIPE, SIG_IGN);
+    return 0;
+}
+
+/// @brief Remove the socket file on exit.
+void editorRemoteCleanup()
+{
+    if (zenRemote.path)
+        unlink(zenRemote.path);
+}
+
+/// @brief Undo the escapes of a TEXT argument in place, and return its length.
+size_t editorRemoteUnescape(char *s)
+{
+    char *out = s;
+    char *start = s;
+    for (; *s; s++)
+    {
+        if (*s == '\\' && s[1])
+        {
+            s++;
+            *out++ = (*s == 'n') ? '\n' : (*s == 't') ? '\t' : (*s == 'r') ? '\r' : *s;
+        }
+        else
+            *out++ = *s;
+    }
+    *out = '\0';
+    return out - start;
+}
+
+/// @brief Clamp a 1-based (row, col) from a request into the buffer, as 0-based indexes.
+void editorRemoteClamp(long row, long col, int *at, int *c)
+{
+    *at = row - 1;
+    if (*at < 0)
+        *at = 0;
+    if (*at > E->numrows)
+        *at = E->numrows;
+    *c = col - 1;
+    if (*c < 0 || *at == E->numrows)
+        *c = 0;
+    if (*at < E->numrows && *c > E->row[*at].size)
+        *c = E->row[*at].size;
+}
+
+/// @brief Find 's' in the rows, starting just after the cursor and wrapping around. Moves the cursor to the match.
+int editorRemoteSearch(const char *s)
+{
+    for (int i = 0; i <= E->numrows; i++)
+    {
+        int r = E->numrows ? (E->cy + i) % E->numrows : 0;
+        if (r >= E->numrows)
+            return -1;
+
+        // The cursor row is searched twice: after the cursor first, and before it once we have wrapped around.
+        erow *row = &E->row[r];
+        int from = (i == 0) ? E->cx + 1 : 0;
+        if (from > row->size)
+            continue;
+        char *match = strstr(&row->chars[from], s);
+        if (match && (i < E->numrows || match - row->chars <= E->cx))
+        {
+            E->cy = r;
+            E->cx = match - row->chars;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/// @brief Queue 'len' bytes of response for a tool. They are sent as it reads them, see editorRemoteFlush().
+void editorRemoteWrite(struct remoteClient *cl, const char *s, size_t len)
+{
+    if (cl->outlen + len > cl->outcap)
+    {
+        cl->outcap = cl->outcap ? cl->outcap * 2 : 4096;
+        if (cl->outcap < cl->outlen + len)
+            cl->outcap = cl->outlen + len;
+        cl->out = editorRealloc(MEM_REMOTE, cl->out, cl->outcap);
+    }
+    memcpy(&cl->out[cl->outlen], s, len);
+    cl->outlen += len;
+}
+
+/// @brief Queue a formatted response line for a tool.
+void editorRemoteReply(struct remoteClient *cl, const char *fmt, ...)
+{
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len >= (int)sizeof(line))
+    {
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n';
+    }
+    editorRemoteWrite(cl, line, len);
+}
+
+/// @brief Send as much of the queued output as the tool takes without blocking. Returns -1 if the tool is gone.
+int editorRemoteFlush(struct remoteClient *cl)
+{
+    while (cl->outpos < cl->outlen)
+    {
+        ssize_t n = send(cl->fd, &cl->out[cl->outpos], cl->outlen - cl->outpos, 0);
+        if (n == -1)
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        cl->outpos += n;
+    }
+    cl->outlen = cl->outpos = 0;
+    return 0;
+}
+
+/// @brief Run one request line and queue the response.
+void editorRemoteRequest(struct remoteClient *cl, char *line)
+{
+    char *arg = line;
+    char *cmd = strsep(&arg, " ");
+    int at, c;
+
+    // The hex view shows bytes, not rows: text edits would go to rows nobody sees, and be lost on save.
+    if (E->hex && strcmp(cmd, "save"))
+    {
+        editorRemoteReply(cl, "err hex view\n");
+        return;
+    }
+
+    if (!strcmp(cmd, "insert") && arg)
+    {
+        long row = strtol(arg, &arg, 10);
+        long col = strtol(arg, &arg, 10);
+        if (*arg == ' ')
+            arg++;
+        size_t len = editorRemoteUnescape(arg);
+        editorRemoteClamp(row, col, &at, &c);
+        editorInsertText(&at, &c, arg, len);
+        editorRemoteReply(cl, "ok %d %d\n", at + 1, c + 1);
+    }
+    else if (!strcmp(cmd, "delete") && arg)
+    {
+        int at2, c2;
+        long r1 = strtol(arg, &arg, 10);
+        long c1 = strtol(arg, &arg, 10);
+        long r2 = strtol(arg, &arg, 10);
+        long cc2 = strtol(arg, &arg, 10);
+        editorRemoteClamp(r1, c1, &at, &c);
+        editorRemoteClamp(r2, cc2, &at2, &c2);
+        if (at2 < at || (at2 == at && c2 < c))
+        {
+            editorRemoteReply(cl, "err range ends before it starts\n");
+            return;
+        }
+        editorDeleteText(at, c, at2, c2);
+        editorRemoteReply(cl, "ok\n");
+    }
+    else if (!strcmp(cmd, "search") && arg)
+    {
+        editorRemoteUnescape(arg);
+        if (*arg && editorRemoteSearch(arg) == 0)
+            editorRemoteReply(cl, "ok %d %d\n", E->cy + 1, E->cx + 1);
+        else
+            editorRemoteReply(cl, "err not found\n");
+    }
+    else if (!strcmp(cmd, "goto") && arg)
+    {
+        long row = strtol(arg, &arg, 10);
+        long col = strtol(arg, &arg, 10);
+        editorRemoteClamp(row, col ? col : 1, &E->cy, &E->cx);
+        editorRemoteReply(cl, "ok %d %d\n", E->cy + 1, E->cx + 1);
+    }
+    else if (!strcmp(cmd, "save"))
+    {
+        if (E->filename == NULL)
+        {
+            editorRemoteReply(cl, "err no filename\n");
+            return;
+        }
+        int ok = (editorSave() == 0);
+        editorRemoteReply(cl, ok ? "ok %s\n" : "err %s\n", E->statusmsg);
+    }
+    else if (!strcmp(cmd, "text"))
+    {
+        long r1 = arg ? strtol(arg, &arg, 10) : 1;
+        long r2 = arg ? strtol(arg, &arg, 10) : 0;
+        if (r1 < 1)
+            r1 = 1;
+        if (r2 == 0 || r2 > E->numrows)
+            r2 = E->numrows;
+        long n = r2 >= r1 ? r2 - r1 + 1 : 0;
+        editorRemoteReply(cl, "ok %ld\n", n);
+        for (long j = r1 - 1; j < r1 - 1 + n; j++)
+        {
+            editorRemoteWrite(cl, E->row[j].chars, E->row[j].size);
+            editorRemoteWrite(cl, "\n", 1);
+        }
+    }
+    else
+    {
+        editorRemoteReply(cl, "err unknown request\n");
+    }
+}
+
+/// @brief Disconnect tool 'i' and forget what it had pending.
+void editorRemoteDrop(int i)
+{
+    struct remoteClient *cl = &zenRemote.clients[i];
+    close(cl->fd);
+    editorFree(MEM_REMOTE, cl->buf);
+    editorFree(MEM_REMOTE, cl->out);
+    zenRemote.clients[i] = zenRemote.clients[--zenRemote.nclients];
+}
+
+/// @brief Count the tools with responses still to send, and if 'fds' is given, fill it in to wait for them to read.
+int editorRemotePending(struct pollfd *fds)
+{
+    int n = 0;
+    for (int i = 0; i < zenRemote.nclients; i++)
+    {
+        if (zenRemote.clients[i].outpos == zenRemote.clients[i].outlen)
+            continue;
+        if (fds)
+            fds[n] = (struct pollfd){zenRemote.clients[i].fd, POLLOUT, 0};
+        n++;
+    }
+    return n;
+}
+
+/// @brief Send more to the tools that 'fds', filled in by editorRemotePending(), shows are ready.
+void editorRemoteSent(struct pollfd *fds, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        for (int i = 0; fds[j].revents && i < zenRemote.nclients; i++)
+        {
+            struct remoteClient *cl = &zenRemote.clients[i];
+            if (cl->fd != fds[j].fd)
+                continue;
+            if (editorRemoteFlush(cl) == -1 || (cl->closing && cl->outlen == 0))
+                editorRemoteDrop(i);
+            break;
+        }
+    }
+}
+
+/// @brief Accept new tools, read whatever they sent, and apply all complete requests as one batch with a single repaint.
+void editorRemotePoll()
+{
+    int fd;
+    while (zenRemote.nclients < ZEN_REMOTE_CLIENTS && (fd = accept(zenRemote.listenfd, NULL, NULL)) != -1)
+    {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        zenRemote.clients[zenRemote.nclients] = (struct remoteClient){.fd = fd};
+        zenRemote.nclients++;
+    }
+
+    int requests = 0;
+    editorBatchBegin();
+    for (int i = 0; i < zenRemote.nclients; i++)
+    {
+        struct remoteClient *cl = &zenRemote.clients[i];
+        char chunk[4096];
+        ssize_t n = -1;
+        errno = EAGAIN;
+        // Reading stops at ZEN_REMOTE_LINE bytes, so a tool sending without end can't keep the editor here.
+        while (!cl->closing && cl->len < ZEN_REMOTE_LINE && (n = recv(cl->fd, chunk, sizeof(chunk), 0)) > 0)
+        {
+            cl->buf = editorRealloc(MEM_REMOTE, cl->buf, cl->len + n);
+            memcpy(&cl->buf[cl->len], chunk, n);
+            cl->len += n;
+        }
+        if (n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+            cl->closing = 1;
+
+        // Run every complete line, keep the incomplete tail for next time.
+        int start = 0;
+        char *nl;
+        while (start < cl->len && (nl = memchr(&cl->buf[start], '\n', cl->len - start)) != NULL)
+        {
+            *nl = '\0';
+            if (nl > &cl->buf[start] && nl[-1] == '\r')
+                nl[-1] = '\0';
+            editorRemoteRequest(cl, &cl->buf[start]);
+            start = nl - cl->buf + 1;
+            requests++;
+        }
+        memmove(cl->buf, &cl->buf[start], cl->len - start);
+        cl->len -= start;
+
+        // What is left is the start of a line: one that already fills the limit will never be taken.
+        if (cl->len >= ZEN_REMOTE_LINE)
+        {
+            editorRemoteReply(cl, "err line too long\n");
+            editorRemoteFlush(cl);
+            editorRemoteDrop(i--);
+            continue;
+        }
+        if (editorRemoteFlush(cl) == -1 || (cl->closing && cl->outlen == 0))
+            editorRemoteDrop(i--);
+    }
+
+    // Requests may have deleted the rows the cursor was on.
+    if (E->cy > E->numrows)
+        E->cy = E->numrows;
+    int rowlen = E->cy < E->numrows ? E->row[E->cy].size : 0;
+    if (E->cx > rowlen)
+        E->cx = rowlen;
+    editorBatchEnd();
+
+    if (requests)
+        editorRefreshScreen();
+}
+
+/*** server ***/
+
+/*
+    'zen --server' keeps running in the background with its buffers loaded. A later 'zen file' connects to it over a Unix
+    domain socket and hands over its terminal with SCM_RIGHTS. The server then draws on that terminal, and when the user
+    quits it keeps the buffer in memory, so opening the same file again only has to swap it back in.
+    One terminal is attached at a time: the frontend has a single screen, terminal mode and key loop. A client that connects
+    while one is attached is told the server is busy, and exits. Once the terminal detaches, the next client can open any
+    buffer left behind by an earlier one.
+*/
+
+/// @brief Socket path: $XDG_RUNTIME_DIR/zen.sock, or /tmp/zen-<uid>.sock.
+void editorServerPath(char *buf, size_t len)
+{
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir)
+        snprintf(buf, len, "%s/zen.sock", dir);
+    else
+        snprintf(buf, len, "/tmp/zen-%d.sock", (int)getuid());
+}
+
+/// @brief Forward SIGWINCH to the server: the client owns the terminal, so it is the one that receives the signal.
+void handleClientSigWinch(int sig)
+{
+    (void)sig;
+    if (zenServer.client != -1)
+        write(zenServer.client, "W", 1);
+}
+
+/// @brief Non-blocking check of the client connection for forwarded resize notifications.
+void editorServerPollClient()
+{
+    char buf[64];
+    ssize_t n;
+    while ((n = recv(zenServer.client, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        if (memchr(buf, 'W', n))
+            zenTerminal.resize_pending = 1;
+    }
+}
+
+/// @brief Tell the clients that connected while a terminal is attached that the server is busy, so they don't hang.
+void editorServerTurnAway()
+{
+    int fd;
+    while ((fd = accept(zenServer.listenfd, NULL, NULL)) != -1)
+    {
+        // Closing drops the terminal the client sent along unread.
+        dprintf(fd, "zen: the server is busy with another terminal\n");
+        close(fd);
+    }
+}
+
+/// @brief Pick up the size of the terminal that just attached.
+void editorAttachTerminal()
+{
+    if (getWindowSize(&E->screenrows, &E->screencols) == -1)
+        die("getWindowSize");
+    E->screenrows -= 2; // Make room for Status Bar and Status message.
+    zenTerminal.resize_pending = 0;
+    E->statusbar_valid = 0;
+    editorInvalidateLayout();
+}
+
+/// @brief Make 'path' the current buffer, pointing E at it among the resident buffers or opening it. A resident buffer
+/// whose file changed on disk is loaded again, or, if it has unsaved changes, kept with a warning: then it returns 1.
+int editorServerSwitchTo(char *path)
+{
+    // The clipboard outlives the buffer it was copied from.
+    editorClipboardMaterialize();
+
+    int j;
+    for (j = 0; j < zenServer.nbuffers; j++)
+    {
+        if (!strcmp(zenServer.buffers[j]->filename, path))
+        {
+            E = zenServer.buffers[j];
+            if (!editorDiskChanged())
+            {
+                editorAttachTerminal();
+                return 0;
+            }
+            if (E->dirty)
+            {
+                editorAttachTerminal();
+                editorSetStatusMessage("WARNING!!! %s changed on disk, saving will overwrite it", path);
+                return 1;
+            }
+            // Unchanged here but changed on disk: load it again.
+            editorFreeBuffer(E);
+            zenServer.buffers[j] = zenServer.buffers[--zenServer.nbuffers];
+            break;
+        }
+    }
+
     initEditor();
-    if (argc >= 2)
+    if (editorOpen(path) == -1)
+    {
+        int err = errno;
+        editorFreeBuffer(E);
+        errno = err;
+        die(path);
+    }
+
+    zenServer.buffers = realloc(zenServer.buffers, sizeof(struct editorConfig *) * (zenServer.nbuffers + 1));
+    zenServer.buffers[zenServer.nbuffers++] = E;
+    return 0;
+}
+
+/// @brief Serve one client: receive its terminal and the file to edit, and run the editor on that terminal until it quits.
+void editorServerSession(int client)
+{
+    char path[4096];
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {path, sizeof(path) - 1};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(client, &msg, 0);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n <= 0 || cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS)
+        return;
+    path[n] = '\0';
+
+    int tty;
+    memcpy(&tty, CMSG_DATA(cmsg), sizeof(int));
+    if (access(path, F_OK) == 0 && access(path, R_OK) == -1)
+    {
+        dprintf(client, "zen: %s: %s\n", path, strerror(errno));
+        close(tty);
+        return;
+    }
+
+    // From now on the client's terminal is our stdin and stdout.
+    dup2(tty, STDIN_FILENO);
+    dup2(tty, STDOUT_FILENO);
+    close(tty);
+
+    zenServer.client = client;
+    zenServer.quit = 0;
+    if (setjmp(zenServer.session_abort) == 0)
+    {
+        enableRawMode();
+        if (editorServerSwitchTo(path) == 0)
+            editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = detach | Ctrl-F = find || 🤖 Made by Harsh Kishorani. 🤖");
+
+        while (!zenServer.quit)
+        {
+            editorRefreshScreen();
+            editorProcessKeypress();
+        }
+    }
+    // Also after die(): the terminal goes back to the client the way it came.
+    disableRawMode();
+
+    zenServer.client = -1;
+
+    // Let go of the client's terminal.
+    int devnull = open("/dev/null", O_RDWR);
+    dup2(devnull, STDIN_FILENO);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+}
+
+int editorServerMain()
+{
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    editorServerPath(path, sizeof(path));
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, sizeof(path));
+
+    // A leftover socket file is only removed if nobody answers on it.
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+    {
+        fprintf(stderr, "zen: a server is already listening on %s\n", path);
+        return 1;
+    }
+    close(probe);
+    unlink(path);
+
+    zenServer.listenfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (zenServer.listenfd == -1 || bind(zenServer.listenfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(zenServer.listenfd, 8) == -1)
+    {
+        perror("zen: server socket");
+        return 1;
+    }
+    chmod(path, 0600);
+    signal(SIGPIPE, SIG_IGN);
+    installSignalHandlers();
+    // Non-blocking, so editorServerTurnAway() can take the clients that are there during a session without waiting for more.
+    fcntl(zenServer.listenfd, F_SETFL, O_NONBLOCK);
+
+    while (1)
+    {
+        struct pollfd pfd = {zenServer.listenfd, POLLIN, 0};
+        poll(&pfd, 1, -1);
+        int client = accept(zenServer.listenfd, NULL, NULL);
+        if (client == -1)
+            continue;
+        fcntl(client, F_SETFL, 0); // Some systems hand the listening socket's O_NONBLOCK on to accepted ones.
+        editorServerSession(client);
+        close(client);
+    }
+    return 0;
+}
+
+/// @brief Hand the terminal and 'filename' to a running server and wait until the user quits there.
+/// Returns -1, without side effects, when no server is running.
+int editorClientMain(char *filename)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    editorServerPath(addr.sun_path, sizeof(addr.sun_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // The server has another working directory, send it an absolute path.
+    char path[4096];
+    if (filename[0] == '/')
+        snprintf(path, sizeof(path), "%s", filename);
+    else
+    {
+        char cwd[2048];
+        if (getcwd(cwd, sizeof(cwd)) == NULL)
+            return -1;
+        snprintf(path, sizeof(path), "%s/%s", cwd, filename);
+    }
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {path, strlen(path)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    int tty = STDIN_FILENO;
+    memcpy(CMSG_DATA(cmsg), &tty, sizeof(int));
+
+    if (sendmsg(fd, &msg, 0) == -1)
     {
-        editorOpen(argv[1]);
+        close(fd);
+        return -1;
+    }
+
+    zenServer.client = fd;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handleClientSigWinch;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+
+    // Anything the server sends back is an error message. The connection closes when the user quits.
+    int status = 0;
+    char buf[256];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0)
+    {
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        write(STDERR_FILENO, buf, n);
+        status = 1;
     }
+    close(fd);
+    return status;
+}
+
+/*
+    Built with -DZEN_NO_MAIN, this file is the frontend without a main(), for programs linked with zen_core.c that drive the
+    editor without a terminal but still want its drawing code, like the benchmarks in bench/.
+*/
+#ifndef ZEN_NO_MAIN
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && !strcmp(argv[1], "--server"))
+        return editorServerMain();
+
+    char *filename = NULL;
+    char *listen_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strncmp(argv[i], "--listen=", 9))
+            listen_path = argv[i] + 9;
+        else if (!strncmp(argv[i], "--trace=", 8))
+            editorTraceStart(argv[i] + 8);
+        else if (!strncmp(argv[i], "--autosave=", 11))
+        {
+            // --autosave=SECONDS[,EDITS]
+            char *end;
+            zenAutosave.seconds = strtol(argv[i] + 11, &end, 10);
+            zenAutosave.edits = (*end == ',') ? strtol(end + 1, NULL, 10) : 0;
+        }
+        else if (filename == NULL)
+            filename = argv[i];
+    }
+
+    // Let a running server open the file if there is one. A remote controlled editor always runs on its own.
+    if (filename && listen_path == NULL)
+    {
+        int status = editorClientMain(filename);
+        if (status != -1)
+            return status;
+    }
+
+    if (listen_path)
+    {
+        if (editorRemoteListen(listen_path) == -1)
+        {
+            perror("zen: --listen");
+            return 1;
+        }
+        atexit(editorRemoteCleanup);
+    }
+
+    enableRawMode();
+    initEditor();
+    if (filename && editorOpen(filename) == -1)
+        die(filename);
 
     editorSetStatusMessage("HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find || 🤖 Made by Harsh Kishorani. 🤖");
+    if (filename && (zenAutosave.seconds || zenAutosave.edits))
+        editorAutosaveNotice();
 
     while (1)
     {
@@ -1568,4 +2314,5 @@ int main(int argc, char *argv[])
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,617 @@
+/*** includes ***/
+
+#ifndef ZEN_H
+#define ZEN_H
+
+/*
+    The editor comes in two parts. zen_core.c is the buffer and everything done to it: rows, highlighting, search, the
+    clipboard, line commands, loading and saving. It never touches the terminal and reports errors by returning -1 (with a
+    status message) instead of exiting. zen.c is the terminal frontend built on it: raw mode, keys, prompts, drawing, the
+    server and remote control. This header is what the two share.
+*/
+
+// Feature test macro : https://www.gnu.org/software/libc/manual/html_node/Feature-Test-Macros.html
+// We add them above our includes, because the header files we’re including use the macros to decide what features to expose.
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <regex.h>
+#include <zlib.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <malloc.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*** defines ***/
+
+#define ZEN_VERSION "0.0.1"
+#define ZEN_TAB_STOP 4
+#define ZEN_QUIT_TIMES 3
+#define ZEN_STATS_DENSE 4096 // Line lengths below this are counted in a flat histogram, longer ones in a sorted list.
+#define ZEN_CACHE_MIN_SIZE (1 << 20) // Files smaller than this open fast enough without a sidecar cache.
+#define ZEN_CACHE_HASH_SPAN (64 * 1024) // Bytes hashed at each end of the file to fingerprint its content.
+#define ZEN_CACHE_MAX_SIZE (256LL << 20) // The least recently used sidecar caches are removed when they add up to more than this.
+#define ZEN_REMOTE_CLIENTS 16 // Tools connected to the remote control socket at the same time.
+#define ZEN_REMOTE_LINE (1 << 20) // Longest request line a tool may send. A longer one gets it disconnected.
+#define ZEN_SORT_THREADS 16 // Upper bound on the threads used by the sort, uniq and filter commands.
+#define ZEN_SORT_SERIAL (1 << 16) // Below this many rows the work of a line command is not split across threads.
+#define ZEN_PIPE_CHUNK (64 * 1024) // Bytes moved to or from a filter command per read() or write().
+#define ZEN_PIPE_BUDGET (4 << 20) // Bytes of filter output taken in before the terminal gets a look.
+#define ZEN_LOAD_CHUNK (1 << 20) // Bytes the loader thread reads or inflates at a time.
+#define ZEN_LOAD_QUEUED (64 << 20) // The loader thread waits while this many bytes are still queued.
+#define ZEN_LOAD_BUDGET (8 << 20) // Bytes of queued text turned into rows before the terminal gets a look.
+#define ZEN_LOAD_ASYNC_SIZE (4 << 20) // Files this large are loaded in the background once the first screen is in.
+#define ZEN_HEX_STRIDE 16 // Bytes per row in the hex view.
+#define ZEN_PERF_SUB_BITS 4 // Timing histograms have 2^ZEN_PERF_SUB_BITS buckets per power of two.
+#define ZEN_PERF_SUB (1 << ZEN_PERF_SUB_BITS)
+#define ZEN_PERF_BUCKETS ((64 - ZEN_PERF_SUB_BITS) << ZEN_PERF_SUB_BITS)
+#define ZEN_TRACE_MAIN_EVENTS (1 << 18) // Trace events kept for the event loop thread...
+#define ZEN_TRACE_EVENTS (1 << 12)      // ...and for each worker thread.
+#define ZEN_BINARY_PROBE 8192 // A NUL byte in this many leading bytes makes editorOpen() show the file in the hex view.
+
+/*
+    The 'CTRL_KEY' macro bitwise-ANDs a character with the value 00011111, in binary.
+    (In C, you generally specify bitmasks using hexadecimal, since C doesn’t have binary literals, and hexadecimal is more concise and
+    readable once you get used to it.)
+
+    In other words, it sets the upper 3 bits of the character to 0.
+    This mirrors what the Ctrl key does in the terminal: it strips bits 5 and 6 from whatever key you press in combination with Ctrl,
+    and sends that.
+    (By convention, bit numbering starts from 0.) The ASCII character set seems to be designed this way on purpose.
+    (It is also similarly designed so that you can set and clear bit 5 to switch between lowercase and uppercase.)
+*/
+#define CTRL_KEY(k) ((k) & 0x1f)
+
+enum editorKey
+{
+    BACKSPACE = 127,
+    ARROW_LEFT = 1000,
+    ARROW_RIGHT,
+    ARROW_UP,
+    ARROW_DOWN,
+    DEL_KEY,
+    HOME_KEY,
+    END_KEY,
+    PAGE_UP,
+    PAGE_DOWN
+};
+
+enum editorHighlight
+{
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER,
+    HL_MATCH
+};
+
+#define HL_HIGHLIGHT_NUMBERS (1 << 0)
+#define HL_HIGHLIGHT_STRINGS (1 << 1)
+
+/*** data ***/
+
+/// @brief struct that will contain all the syntax highlighting information for a particular filetype.
+struct editorSyntax
+{
+    char *filetype;                 // The filetype field is the name of the filetype that will be displayed to the user in the status bar.
+    char **filematch;               // filematch is an array of strings, where each string contains a pattern to match a filename against. If the filename matches, then the file will be recognized as having that filetype.
+    char **keywords;                // NULL-terminated array of strings, each string containing a keyword. To differentiate between the two types of keywords, terminate the second type of keywords with a pipe (|) character (also known as a vertical bar).
+    char *singleline_comment_start; // let each language specify its own single-line comment pattern
+    char *multiline_comment_start;
+    char *multiline_comment_end;
+    int flags; // flags is a bit field that will contain flags for whether to highlight numbers and whether to highlight strings for that filetype. eg HL_HIGHLIGHT_NUMBERS
+};
+
+/// @brief Data type for storing a row of text in our editor.
+typedef struct erow
+{
+    int idx; // erow knows its own index within the file.
+    int size;
+    int rsize; // Contains the size of the contents of 'render'.
+    char *chars;
+    char *render;      // Contains the actual characters to draw on the screen for that row of text.
+    unsigned char *hl; // store the highlighting of each line in an array. NULL until the row is first highlighted, and for an empty row.
+    int hl_valid;      // 'hl' matches 'render': cleared while highlighting is deferred (see editorRowHighlight()).
+    int hl_open_comment;
+    int wraps;    // Number of visual lines this row occupies when soft-wrap is on, as held by the wrap index.
+    int wrapcols; // Text width 'wraps' was computed for. The row is laid out again when it is visited at another width.
+    int words;  // Words in the row, as counted into E->stats.
+    int nchars; // UTF-8 characters in the row, as counted into E->stats.
+    int crlf;   // The row ends in "\r\n" in the file, not in "\n".
+} erow;
+
+/// @brief Document statistics, updated by the row primitives with per-row deltas so reading them never scans the file.
+struct editorStats
+{
+    long long words;
+    long long chars;    // UTF-8 characters, not counting newlines.
+    int *lenhist;       // lenhist[n] is the number of rows that are n bytes long, for n < ZEN_STATS_DENSE.
+    int dense_max;      // Longest row length with a non-zero lenhist entry.
+    int *longlens;      // Sorted lengths of the rows that are ZEN_STATS_DENSE bytes or longer. There are few of those.
+    int nlonglens;
+    int longlens_cap;
+};
+
+/// @brief An extra cursor, in chars coordinates like E->cx and E->cy.
+struct editorCursor
+{
+    int cx, cy;
+};
+
+/// @brief Everything the status bar shows. The bar is only rebuilt and re-emitted when one of these changes.
+struct statusFields
+{
+    char *filename;
+    struct editorSyntax *syntax;
+    int numrows;
+    int modified;
+    int line;
+    int col;
+    long long offset;
+    long long total;
+    long long selection; // Size of the selection in bytes, -1 when nothing is selected.
+};
+
+/// @brief Header of the sidecar cache file that lets editorOpen() skip splitting and highlighting a file it has seen before.
+/*
+    The header is followed by 'numrows' uint64_t offsets of the start of each line, and then one bit per row holding its
+    hl_open_comment state, so any row can be highlighted on its own without highlighting the rows above it first.
+*/
+struct editorCacheHeader
+{
+    char magic[8];
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t hash;     // Hash of the first and last ZEN_CACHE_HASH_SPAN bytes of the file.
+    uint64_t syntax;   // Hash of the filetype the comment states were computed with.
+    uint64_t numrows;
+};
+
+#define ZEN_CACHE_MAGIC "ZENIDX1"
+
+#define ROWIDX_LEAF 128   // Row weights held by a leaf of a row index.
+#define ROWIDX_FANOUT 32  // Children of an inner node of a row index.
+
+/// @brief Node of a row index. Leaves hold the weights of consecutive rows, and inner nodes the row count and weight sum of each child.
+struct rowIndexNode
+{
+    int n;    // Weights in a leaf, or children of an inner node.
+    int leaf;
+    union
+    {
+        long long w[ROWIDX_LEAF];
+        struct
+        {
+            struct rowIndexNode *child[ROWIDX_FANOUT];
+            int rows[ROWIDX_FANOUT];
+            long long sum[ROWIDX_FANOUT];
+        } in;
+    } u;
+};
+
+/// @brief Counted B+tree holding one weight per row, so that prefix sums, "which row holds the n-th unit", and inserting or
+/// removing a row anywhere in the file are all O(log n).
+struct rowIndex
+{
+    struct rowIndexNode *root;
+    int size;  // Rows in the tree.
+    int stale; // Set when the weights changed meaning, or moved between rows. The tree is rebuilt on next use.
+    long long (*weight)(erow *row); // Computes the weight of a row when the tree is rebuilt.
+};
+
+/// @brief Hex view of a file, shown instead of rows of text. The file is only mapped, never split, so any size opens at once.
+struct editorHex
+{
+    unsigned char *data; // The file, mapped copy-on-write: edits change the mapping, not the file, until it is saved.
+    size_t size;
+    size_t cursor; // Offset of the byte under the cursor.
+    int low;       // The cursor is on the low nibble of that byte.
+    size_t top;    // First row on screen.
+    size_t dirty_lo, dirty_hi; // Bytes [dirty_lo, dirty_hi) changed since the last save.
+};
+
+/// @brief One line of clipboard text, without its newline.
+struct clipLine
+{
+    char *s;
+    int len;
+};
+
+/// @brief The clipboard, shared by all buffers.
+/*
+    Copying does not copy anything: it records which span of the buffer was copied. The text is only copied out of the rows
+    (materialized) when one of those rows is about to change, is deleted, or the buffer is swapped out, so copying even a huge
+    selection is O(1) in time and memory.
+*/
+struct editorClipboard
+{
+    int live;               // The text is (r1, c1) up to, but not including, (r2, c2) of the current buffer.
+    int r1, c1, r2, c2;
+    struct clipLine *lines; // Otherwise the clipboard owns these 'nlines' lines.
+    int nlines;
+    int block;              // The lines were copied from a block selection and are pasted as a block.
+};
+
+/// @brief A command the rows [y1, y1 + n) are being filtered through.
+/*
+    Rows are streamed to the command's stdin as the pipe accepts them, and a row that has been handed over is emptied at once.
+    Output lines reuse the slots of those emptied rows, in order, so the buffer never holds the input and the output in
+    full at the same time. Output lines that arrive before there is a free slot wait in 'pending'.
+
+    What is handed over is also written to 'spill', a temporary file, so the rows can be put back as they were when the
+    command is aborted or fails: its output only replaces them once it has exited with status 0.
+*/
+struct editorPipe
+{
+    pid_t pid; // 0 when no command is running.
+    int infd;  // Our end of the command's stdin, -1 once all the input is written.
+    int outfd; // Our end of the command's stdout.
+    int y1, n;
+    int sent;         // Rows fully handed over to the command, they are the free slots.
+    int filled;       // Slots holding output.
+    int wrow, woff;   // Next row and byte to copy into 'stage' (woff == size means its newline).
+    char stage[ZEN_PIPE_CHUNK];
+    int stagepos, stagelen;
+    char *partial; // Output line still waiting for its newline.
+    int partlen;
+    struct clipLine *pending; // Output lines with no slot yet, from 'phead' on.
+    int npending, phead, pcap;
+    long long bytesout;
+    FILE *spill; // The rows handed over so far, one per line.
+};
+
+/// @brief Incremental search through the buffer, see editorFindCallback().
+struct editorSearch
+{
+    int last_match;    // Row of the last match, -1 if there was none.
+    int direction;     // 1 searching forward, -1 backward.
+    int saved_hl_line; // Row whose highlighting the match marker covers,
+    char *saved_hl;    // and the highlighting to put back, or NULL.
+};
+
+/// @brief Auto-save settings, from --autosave. They apply to every buffer.
+struct autosaveSettings
+{
+    int seconds, edits; // Back up after this many seconds without edits, or after this many edits. 0 disables either.
+};
+
+/// @brief State of the backups of one buffer.
+struct editorAutosave
+{
+    pid_t pid;          // Child writing a backup.
+    int saved;          // E->dirty when the last backup was started...
+    int seen;           // ...and when it was last looked at,
+    struct timespec changed; // which was when it last changed.
+    int written;        // A backup was written since the buffer was last saved.
+};
+
+/// @brief Timed stages of the editor, see editorPerfEnd().
+enum perfStage
+{
+    PERF_KEYPRESS,   // Handling one key, from editorProcessKeypress() (prompts included).
+    PERF_UPDATE_ROW, // Rendering a row's text in editorUpdateRow().
+    PERF_SYNTAX,     // Highlighting after an edit, editorUpdateSyntax() and editorHighlightRange().
+    PERF_DRAW_ROWS,  // Composing the text area.
+    PERF_WRITE,      // The write() of a frame to the terminal.
+    PERF_FRAME,      // All of editorRefreshScreen().
+    PERF_DECODE,     // Turning the bytes of a key into a key code, escape sequences included.
+    PERF_EDIT,       // The row primitives: inserting and deleting rows and characters.
+    PERF_STAGES
+};
+
+struct perfHist
+{
+    uint64_t buckets[ZEN_PERF_BUCKETS];
+    uint64_t count, sum, max; // In ticks, like the buckets.
+};
+
+struct traceEvent
+{
+    const char *name;
+    uint64_t start, end; // In ticks.
+};
+
+/// @brief Trace events of one thread, see editorTraceSpan().
+struct traceRing
+{
+    struct traceRing *next;
+    int tid;
+    int main; // Recorded by the event loop thread.
+    int busy; // Owned by a running thread.
+    uint64_t head; // Events recorded so far. Only the owner writes it.
+    size_t cap; // A power of two.
+    struct traceEvent ev[];
+};
+
+/// @brief Latency histograms of the hot paths, and the trace (--trace).
+struct editorPerf
+{
+    struct perfHist stage[PERF_STAGES];
+    int overlay; // Show p50/p99/max of each stage over the text.
+    uint64_t tick0; // Tick count and time of the first span, to turn ticks into nanoseconds.
+    struct timespec ts0;
+    char *trace; // File the trace is written to at exit, NULL when not tracing.
+    struct traceRing *rings;
+    int nrings;
+    pthread_key_t ring_key; // Ring of the calling thread.
+    pthread_t main_thread;
+};
+
+/// @brief Categories of the memory accounting, see editorRealloc().
+enum memCategory
+{
+    MEM_CHARS,     // Text of the rows.
+    MEM_RENDER,    // Rendered text of the rows.
+    MEM_HL,        // Highlighting of the rows.
+    MEM_ROWS,      // The E->row array.
+    MEM_INDEX,     // Trees of the row indexes.
+    MEM_CLIPBOARD, // Text owned by the clipboard.
+    MEM_OUTPUT,    // Frames being composed.
+    MEM_STATS,     // Line length statistics.
+    MEM_PIPE,      // Output of a filter command waiting for its row.
+    MEM_REMOTE,    // Requests and replies of remote control tools.
+    MEM_CATEGORIES
+};
+
+struct editorHeap
+{
+    long long bytes[MEM_CATEGORIES];
+    long long blocks[MEM_CATEGORIES];
+    long long peak[MEM_CATEGORIES];
+};
+
+/// @brief A block of text handed from the loader thread to the event loop.
+struct loadChunk
+{
+    struct loadChunk *next;
+    size_t len;
+    const char *text; // Points into the mapping for plain files, at 'data' for inflated ones.
+    char data[];
+};
+
+/// @brief A file being loaded in the background. A thread reads (or inflates) it and queues the text, the event loop turns it into rows as it arrives.
+struct editorLoader
+{
+    int active;
+    pthread_t thread;
+    gzFile gz;         // Compressed files...
+    const char *map;   // ...or plain ones, read from the mapping.
+    size_t size, from; // Size of the mapping, and where the thread starts in it.
+    size_t taken;      // Bytes turned into rows so far.
+    int notify[2];     // The thread writes a byte to notify[1] whenever it queues a chunk or finishes.
+    pthread_mutex_t lock;
+    pthread_cond_t drained; // Signalled when the event loop takes from the queue, for a thread waiting on ZEN_LOAD_QUEUED.
+    struct loadChunk *head, *tail; // Queue, under 'lock' like the fields below.
+    size_t queued;
+    int done;  // The thread has queued its last chunk.
+    int error; // ...because of a corrupt or truncated file.
+    int cancel;
+    char *partial; // Start of a line split across chunks (event loop only, like the fields below).
+    int partlen;
+    struct stat st;    // For the sidecar cache of a plain file, written when the load completes...
+    uint64_t *offsets; // ...from the offset of every line.
+    size_t noffsets, offcap;
+    struct editorCacheHeader *cache; // A warm load cuts the rows at the offsets of a valid sidecar cache instead.
+    size_t cachelen;
+    uint64_t cached; // The next row of the cache to cut.
+};
+
+// Create our own dynamic string type that supports one operation: appending.
+struct abuf
+{
+    char *b;
+    int len;
+};
+
+#define ABUF_INIT {NULL, 0}
+
+struct editorConfig
+{
+    int cx, cy; // Cursor co-ordinates
+    int rx;     // x variable index into the render field.
+    int rowoff; // Keep track of what row of the file the user is currently scrolled to
+    int coloff; // Keep track of what col of the file the user is currently scrolled to
+    int numrows;
+    erow *row;
+    int dirty;
+    int screenrows;
+    int screencols;
+    char *filename;
+    char statusmsg[80];
+    time_t statusmsg_time;
+    struct editorSyntax *syntax; // When E->syntax is NULL, that means there is no filetype for the current file, and no syntax highlighting should be done
+    int wrap;                    // Soft-wrap mode. When set, E->rowoff counts visual lines instead of file rows and E->coloff stays 0.
+    struct rowIndex wrapidx;     // Prefix sums over the visual line count of each row.
+    int linenums;                // Show the line-number gutter.
+    int gutter;                  // Width of the gutter in columns (digits plus a space), 0 when hidden.
+    int gutter_min, gutter_max;  // The gutter width is valid while gutter_min <= E->numrows < gutter_max.
+    struct rowIndex byteidx;     // Prefix sums over the byte size of each row (including its newline), for the cursor's file offset.
+    long long totalbytes;        // Bytes of all rows with their line endings, kept up to date by the row primitives.
+    struct statusFields *status; // What the status bar showed last frame.
+    char *statusbar;             // The last status bar, padded to the screen width.
+    struct editorStats stats;
+    int defer_syntax; // While non-zero, editorUpdateRow() leaves highlighting to be done lazily when the row is drawn, or by editorBatchEnd().
+    int batch_lo, batch_hi; // Rows edited during the current batch.
+    struct editorCursor *cursors; // Extra cursors besides (E->cx, E->cy), kept sorted by position.
+    int ncursors;
+    int cursors_cap;
+    int sel_active;     // A selection runs from the anchor (sel_cy, sel_cx) to the cursor.
+    int sel_cy, sel_cx;
+    int sel_block;      // The selection is the rectangle between the anchor and the cursor, in render columns.
+    struct editorHex *hex; // Non-NULL when the buffer is shown in the hex view.
+    int compressed;        // Save the file gzip-compressed.
+    int crlf;              // New rows end in "\r\n", like the first line of the file.
+    int bom;               // The file starts with a UTF-8 byte order mark, which is not part of the first row.
+    int noeol;             // The last row has no line ending in the file.
+    int partial;           // Loading stopped part way, so the rows are not the whole file and editorSave() won't write over it.
+    struct timespec disk_mtime; // Modification time and size of the file when it was last opened or saved, see editorDiskChanged().
+    off_t disk_size;
+    struct editorPipe pipe;         // Command the rows are being filtered through, if any.
+    struct editorLoader load;       // Loading of the rest of the file in the background, if any.
+    struct editorAutosave autosave; // Backups of the unsaved changes.
+    struct editorSearch search;     // Search in progress.
+    int stats_panel; // Show the statistics panel.
+    int statusbar_valid;         // Cleared when the status bar must be re-emitted even if its fields did not change (resize, first frame).
+};
+
+/*
+    All the state of one buffer is in a struct editorConfig, including the filter command, background load, backups and
+    search running for it. The core functions take no buffer argument, they all work on the one E points to. Several
+    buffers can live in one process, the server keeps one for every file it has open, but only by pointing E at each in
+    turn: one buffer is worked on at a time, by the main thread. The core is not reentrant, and two threads can't use two
+    buffers. E and the state shared by all buffers below are defined in zen_core.c.
+*/
+extern struct editorConfig *E;
+extern struct editorClipboard zenClipboard;
+extern struct autosaveSettings zenAutosave;
+extern const char *perfStageNames[PERF_STAGES];
+extern struct editorPerf zenPerf;
+extern const char *memCategoryNames[MEM_CATEGORIES];
+extern struct editorHeap zenHeap;
+
+/*** prototypes ***/
+
+// instrumentation
+uint64_t editorPerfNow();
+double editorPerfNanos();
+void editorTraceStart(char *path);
+void editorPerfEnd(int stage, uint64_t start);
+uint64_t editorPerfPercentile(struct perfHist *h, double q);
+void editorPerfFormat(char *buf, size_t len, uint64_t ticks, double scale);
+
+// memory accounting
+void *editorMalloc(int cat, size_t size);
+void *editorRealloc(int cat, void *p, size_t size);
+void editorFree(int cat, void *p);
+void editorMemReport(FILE *fp);
+
+// syntax highlighting
+void editorUpdateSyntax(erow *row);
+void editorBatchBegin();
+void editorBatchEnd();
+void editorRowHighlight(erow *row);
+int editorSyntaxToColor(int hl);
+void editorSelectSyntaxHighlight();
+
+// soft wrap
+int editorTextCols();
+int editorRowToVline(int at);
+int editorVlineToRow(int vline, int *sub);
+int editorCursorVline();
+int editorRowWraps(int at);
+void editorInvalidateLayout();
+void editorToggleWrap();
+
+// line numbers
+void editorToggleLineNumbers();
+void editorFormatLineNumber(char *buf, int n);
+void editorIncrementLineNumber(char *buf);
+
+// statistics
+int editorStatsLongest();
+void editorToggleStatsPanel();
+
+// clipboard
+void editorClipboardMaterialize();
+
+// row operations
+long long editorCursorOffset();
+int editorRowCxToRx(erow *row, int cx);
+int editorRowRxToCx(erow *row, int rx);
+void editorUpdateRow(erow *row);
+void editorInsertRows(int at, const struct clipLine *lines, int n);
+void editorDelRows(int at, int n);
+
+// editor operations
+void editorInsertChar(int c);
+void editorInsertNewline();
+void editorInsertText(int *at, int *col, const char *s, size_t len);
+void editorDeleteText(int r1, int c1, int r2, int c2);
+void editorDelChar();
+
+// multiple cursors
+void editorCursorAddNextMatch();
+void editorCursorAddLines(int target);
+int editorMultiKeypress(int c);
+
+// selection
+void editorSelectionToggle();
+void editorBlockToggle();
+int editorBlockKeypress(int c);
+int editorSelectionRender(int at, int *rx1, int *rx2);
+long long editorSelectionSize();
+void editorCopy();
+void editorCut();
+void editorPaste();
+
+// filter through command
+void editorPipeFinish(int aborted);
+void editorPipeService(short inready, short outready);
+
+// line commands
+void editorCommand(char *line);
+
+// file i/o
+char *editorRowsToString(int *buflen);
+int editorOpen(char *filename);
+int editorSave();
+void editorDiskStamp();
+int editorDiskChanged();
+
+// background loading
+void editorLoadFinish(int cancel);
+void editorLoadService();
+
+// auto-save
+void editorAutosave();
+void editorAutosaveNotice();
+
+// find
+void editorFindCallback(char *query, int key);
+
+// append buffer
+void abAppend(struct abuf *ab, const char *s, int len);
+void abFree(struct abuf *ab);
+
+// buffers
+struct editorConfig *editorNewBuffer();
+void editorFreeBuffer(struct editorConfig *ed);
+void editorSetStatusMessage(const char *fmt, ...);
+
+// Frontend functions that work without a terminal, in zen.c. editorRefreshScreen() writes the frame to stdout, whatever that is.
+void editorRefreshScreen();
+void editorProcessKey(int c);
+void editorDrawRows(struct abuf *ab);
+
+#endif
@@ -0,0 +1,4799 @@
+/*** includes ***/
+
+#include "zen.h"
+
+/*** data ***/
+
+struct editorConfig *E;
+struct editorClipboard zenClipboard;
+struct autosaveSettings zenAutosave;
+const char *perfStageNames[PERF_STAGES] = {"keypress", "update_row", "syntax", "draw_rows", "write", "frame", "decode", "edit"};
+struct editorPerf zenPerf;
+const char *memCategoryNames[MEM_CATEGORIES] = {"chars", "render", "hl", "rows", "index", "clipboard", "output", "stats", "pipe", "remote"};
+struct editorHeap zenHeap;
+
+/*** filetypes ***/
+
+char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
+
+char *C_HL_keywords[] = {
+    "switch", "if", "while", "for", "break", "continue", "return", "else",
+    "struct", "union", "typedef", "static", "enum", "class", "case",
+    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
+    "void|", NULL};
+
+/// @brief HLDB stands for “highlight database”
+struct editorSyntax HLDB[] = {
+    {"c",
+     C_HL_extensions,
+     C_HL_keywords,
+     "//", "/*", "*/",
+     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS},
+};
+
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+/*** prototypes ***/
+
+void editorTraceFlush();
+int editorGunzipStart(int fd);
+int editorLoadMapStart(const char *data, struct stat *st, size_t from, uint64_t *offsets, size_t n, size_t cap);
+int editorLoadCacheStart(const char *data, struct stat *st, struct editorCacheHeader *cache, size_t cachelen, uint64_t from);
+int editorGzipWrite(int fd);
+void editorHexOpen(unsigned char *data, size_t size);
+int editorHexSave();
+void editorHexToggle();
+
+/*** instrumentation ***/
+
+/*
+    The hot paths are timed with spans: editorPerfNow() at the start, editorPerfEnd() at the end. A span costs two reads of
+    the time stamp counter (or of the monotonic clock elsewhere) and a histogram increment, so it is always on. Histograms
+    are HDR-style: exact below 32 ticks, then 16 buckets per power of two, which keeps every value within about 6% with a
+    fixed 976 buckets per stage. Only the event loop thread records spans, so nothing is locked.
+*/
+
+/// @brief Current time in ticks: TSC cycles on x86, nanoseconds elsewhere.
+uint64_t editorPerfNow()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/// @brief Histogram bucket of a duration of 'v' ticks.
+int editorPerfBucket(uint64_t v)
+{
+    if (v < 2 * ZEN_PERF_SUB)
+        return v;
+    int e = 63 - __builtin_clzll(v); // Position of the top bit, at least 5.
+    return ((e - ZEN_PERF_SUB_BITS) << ZEN_PERF_SUB_BITS) + (v >> (e - ZEN_PERF_SUB_BITS));
+}
+
+/// @brief Smallest duration that falls into bucket 'i'.
+uint64_t editorPerfBucketLow(int i)
+{
+    if (i < 2 * ZEN_PERF_SUB)
+        return i;
+    int e = (i >> ZEN_PERF_SUB_BITS) + ZEN_PERF_SUB_BITS - 1;
+    return (uint64_t)(i - ((e - ZEN_PERF_SUB_BITS) << ZEN_PERF_SUB_BITS)) << (e - ZEN_PERF_SUB_BITS);
+}
+
+/// @brief Nanoseconds per tick, measured between the first span and now.
+double editorPerfNanos()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ticks = editorPerfNow() - zenPerf.tick0;
+    double ns = (now.tv_sec - zenPerf.ts0.tv_sec) * 1e9 + (now.tv_nsec - zenPerf.ts0.tv_nsec);
+    return (zenPerf.tick0 && ticks > 0) ? ns / ticks : 0.0;
+#else
+    return 1.0;
+#endif
+}
+
+/*
+    With --trace=FILE, spans are also kept as trace events and written to FILE in Chrome's trace event format when the
+    editor exits, for Perfetto or chrome://tracing. Every thread records into a ring buffer of its own, so recording takes
+    no lock: the ring has a single writer, and the reader at exit only needs to see its head. Rings are taken from a list
+    that is only ever pushed to, and a finished thread gives its ring back for the next thread to continue in.
+*/
+
+/// @brief Ring buffer of the calling thread, claiming a free one or adding a new one on its first event.
+struct traceRing *editorTraceRing()
+{
+    struct traceRing *r = pthread_getspecific(zenPerf.ring_key);
+    if (r)
+        return r;
+
+    for (r = __atomic_load_n(&zenPerf.rings, __ATOMIC_ACQUIRE); r; r = r->next)
+    {
+        int idle = 0;
+        if (__atomic_compare_exchange_n(&r->busy, &idle, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+    }
+    if (r == NULL)
+    {
+        int main = pthread_equal(pthread_self(), zenPerf.main_thread);
+        size_t cap = main ? ZEN_TRACE_MAIN_EVENTS : ZEN_TRACE_EVENTS;
+        r = calloc(1, sizeof(struct traceRing) + cap * sizeof(struct traceEvent));
+        r->cap = cap;
+        r->busy = 1;
+        r->tid = __atomic_add_fetch(&zenPerf.nrings, 1, __ATOMIC_RELAXED);
+        r->main = main;
+        r->next = __atomic_load_n(&zenPerf.rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&zenPerf.rings, &r->next, r, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(zenPerf.ring_key, r);
+    return r;
+}
+
+/// @brief Thread exit: give the ring back. Its events stay in it.
+void editorTraceRelease(void *ring)
+{
+    __atomic_store_n(&((struct traceRing *)ring)->busy, 0, __ATOMIC_RELEASE);
+}
+
+/// @brief Record the span [start, end) called 'name' (a string literal) on the calling thread, when tracing.
+void editorTraceSpan(const char *name, uint64_t start, uint64_t end)
+{
+    if (zenPerf.trace == NULL)
+        return;
+    struct traceRing *r = editorTraceRing();
+    struct traceEvent *ev = &r->ev[r->head & (r->cap - 1)];
+    ev->name = name;
+    ev->start = start;
+    ev->end = end;
+    __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE); // Oldest events are overwritten once the ring is full.
+}
+
+/// @brief Start tracing into 'path' at exit.
+void editorTraceStart(char *path)
+{
+    zenPerf.trace = path;
+    zenPerf.main_thread = pthread_self();
+    pthread_key_create(&zenPerf.ring_key, editorTraceRelease);
+    zenPerf.tick0 = editorPerfNow();
+    clock_gettime(CLOCK_MONOTONIC, &zenPerf.ts0);
+    atexit(editorTraceFlush);
+}
+
+/// @brief atexit() handler: write every ring out as complete ("X") events, timestamps in microseconds since tracing started.
+void editorTraceFlush()
+{
+    FILE *fp = fopen(zenPerf.trace, "w");
+    if (fp == NULL)
+        return;
+    double scale = editorPerfNanos() / 1e3;
+    const char *sep = "";
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (struct traceRing *r = __atomic_load_n(&zenPerf.rings, __ATOMIC_ACQUIRE); r; r = r->next)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), r->main ? "main" : "worker %d", r->tid);
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", sep, r->tid, label);
+        sep = ",\n";
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > r->cap ? head - r->cap : 0;
+        for (uint64_t i = first; i < head; i++)
+        {
+            struct traceEvent *ev = &r->ev[i & (r->cap - 1)];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", ev->name, r->tid,
+                    (double)(int64_t)(ev->start - zenPerf.tick0) * scale, (double)(ev->end - ev->start) * scale);
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(fp);
+}
+
+/// @brief Close a span opened at 'start' and count it into the histogram of 'stage'. 'name' is the span's name in a trace.
+void editorPerfSpan(int stage, const char *name, uint64_t start)
+{
+    uint64_t now = editorPerfNow();
+    uint64_t d = now > start ? now - start : 0;
+    struct perfHist *h = &zenPerf.stage[stage];
+    h->buckets[editorPerfBucket(d)]++;
+    h->count++;
+    h->sum += d;
+    if (d > h->max)
+        h->max = d;
+
+    // The first span fixes one end of the tick to nanosecond calibration, see editorPerfNanos().
+    if (zenPerf.tick0 == 0)
+    {
+        zenPerf.tick0 = now;
+        clock_gettime(CLOCK_MONOTONIC, &zenPerf.ts0);
+    }
+    editorTraceSpan(name, start, now);
+}
+
+void editorPerfEnd(int stage, uint64_t start)
+{
+    editorPerfSpan(stage, perfStageNames[stage], start);
+}
+
+/// @brief Duration in ticks below which a fraction 'q' of the spans of a stage fall (the middle of that bucket).
+uint64_t editorPerfPercentile(struct perfHist *h, double q)
+{
+    uint64_t rank = (uint64_t)(q * h->count + 0.5), seen = 0;
+    if (rank == 0)
+        rank = 1;
+    for (int i = 0; i < ZEN_PERF_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t mid = (editorPerfBucketLow(i) + editorPerfBucketLow(i + 1)) / 2;
+            return mid < h->max ? mid : h->max;
+        }
+    }
+    return h->max;
+}
+
+/// @brief Format a duration of 'ticks' for the overlay, in at most 7 characters.
+void editorPerfFormat(char *buf, size_t len, uint64_t ticks, double scale)
+{
+    double ns = ticks * scale;
+    if (scale == 0.0)
+        snprintf(buf, len, "?");
+    else if (ns < 1e3)
+        snprintf(buf, len, "%.0fns", ns);
+    else if (ns < 1e6)
+        snprintf(buf, len, "%.1fus", ns / 1e3);
+    else if (ns < 1e9)
+        snprintf(buf, len, "%.1fms", ns / 1e6);
+    else
+        snprintf(buf, len, "%.1fs", ns / 1e9);
+}
+
+/// @brief Write every stage's latency distribution to 'path', one tab separated line per stage, in microseconds.
+int editorPerfDump(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return -1;
+    double scale = editorPerfNanos() / 1e3;
+    fprintf(fp, "stage\tcount\tmean_us\tp50_us\tp90_us\tp99_us\tp999_us\tmax_us\n");
+    for (int s = 0; s < PERF_STAGES; s++)
+    {
+        struct perfHist *h = &zenPerf.stage[s];
+        fprintf(fp, "%s\t%llu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", perfStageNames[s], (unsigned long long)h->count,
+                h->count ? (double)h->sum / h->count * scale : 0.0,
+                editorPerfPercentile(h, 0.5) * scale, editorPerfPercentile(h, 0.9) * scale,
+                editorPerfPercentile(h, 0.99) * scale, editorPerfPercentile(h, 0.999) * scale, h->max * scale);
+    }
+    return fclose(fp);
+}
+
+/// @brief The 'perf' command: toggle the overlay, 'perf reset' clears the histograms, 'perf dump FILE' writes them out.
+void editorPerfCommand(char *arg)
+{
+    if (arg == NULL)
+    {
+        zenPerf.overlay = !zenPerf.overlay;
+    }
+    else if (!strcmp(arg, "reset"))
+    {
+        memset(zenPerf.stage, 0, sizeof(zenPerf.stage));
+        editorSetStatusMessage("Timings cleared");
+    }
+    else if (!strncmp(arg, "dump ", 5) && arg[5])
+    {
+        if (editorPerfDump(arg + 5) == 0)
+            editorSetStatusMessage("Timings written to %s", arg + 5);
+        else
+            editorSetStatusMessage("Can't write %s: %s", arg + 5, strerror(errno));
+    }
+    else
+    {
+        editorSetStatusMessage("Usage: perf [reset | dump FILE]");
+    }
+}
+
+/*** memory accounting ***/
+
+/*
+    The allocations that grow with the file go through editorRealloc() and editorFree() with a category, which keep the
+    live bytes (as malloc_usable_size() reports them, so allocator rounding is included) and blocks of each category.
+    Text that changes hands, like a cut line moving from a row to the clipboard, is moved between categories with
+    editorMemMove(). Only the event loop thread allocates these, so the counters are plain integers.
+*/
+
+/// @brief Add (sign 1) or remove (sign -1) the block 'p' to or from the counters of 'cat'.
+void editorMemCount(int cat, void *p, int sign)
+{
+    if (p == NULL)
+        return;
+    zenHeap.bytes[cat] += sign * (long long)malloc_usable_size(p);
+    zenHeap.blocks[cat] += sign;
+    if (zenHeap.bytes[cat] > zenHeap.peak[cat])
+        zenHeap.peak[cat] = zenHeap.bytes[cat];
+}
+
+/// @brief realloc() counted under 'cat'.
+void *editorRealloc(int cat, void *p, size_t size)
+{
+    editorMemCount(cat, p, -1);
+    void *q = realloc(p, size);
+    if (q == NULL && size)
+    {
+        // There is no way to go on without the memory. exit() still restores the terminal, through atexit().
+        perror("zen: realloc");
+        exit(1);
+    }
+    editorMemCount(cat, q, 1);
+    return q;
+}
+
+/// @brief malloc() counted under 'cat'.
+void *editorMalloc(int cat, size_t size)
+{
+    return editorRealloc(cat, NULL, size);
+}
+
+/// @brief free() of a block counted under 'cat'.
+void editorFree(int cat, void *p)
+{
+    editorMemCount(cat, p, -1);
+    free(p);
+}
+
+/// @brief The block 'p' now belongs to category 'to' instead of 'from'.
+void editorMemMove(int from, int to, void *p)
+{
+    editorMemCount(from, p, -1);
+    editorMemCount(to, p, 1);
+}
+
+/// @brief Write the memory report: bytes, blocks, peak and bytes per line of every category, and the process's resident size.
+void editorMemReport(FILE *fp)
+{
+    long long total = 0, blocks = 0;
+    long lines = E->numrows ? E->numrows : 1;
+    fprintf(fp, "category\tbytes\tblocks\tpeak_bytes\tbytes_per_line\n");
+    for (int i = 0; i < MEM_CATEGORIES; i++)
+    {
+        fprintf(fp, "%s\t%lld\t%lld\t%lld\t%.1f\n", memCategoryNames[i], zenHeap.bytes[i], zenHeap.blocks[i], zenHeap.peak[i], (double)zenHeap.bytes[i] / lines);
+        total += zenHeap.bytes[i];
+        blocks += zenHeap.blocks[i];
+    }
+    fprintf(fp, "total\t%lld\t%lld\t\t%.1f\n", total, blocks, (double)total / lines);
+
+    long pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm && fscanf(statm, "%ld %ld", &pages, &resident) == 2)
+        fprintf(fp, "rss\t%lld\t\t\t%.1f\n", (long long)resident * sysconf(_SC_PAGESIZE), (double)resident * sysconf(_SC_PAGESIZE) / lines);
+    if (statm)
+        fclose(statm);
+}
+
+/// @brief The 'mem' command: show the breakdown in the status bar, or write the full report to a file with 'mem dump FILE'.
+void editorMemCommand(char *arg)
+{
+    if (arg && !strncmp(arg, "dump ", 5) && arg[5])
+    {
+        FILE *fp = fopen(arg + 5, "w");
+        if (fp == NULL)
+        {
+            editorSetStatusMessage("Can't write %s: %s", arg + 5, strerror(errno));
+            return;
+        }
+        editorMemReport(fp);
+        fclose(fp);
+        editorSetStatusMessage("Memory report written to %s", arg + 5);
+        return;
+    }
+    if (arg)
+    {
+        editorSetStatusMessage("Usage: mem [dump FILE]");
+        return;
+    }
+
+    // The status message has room for the bytes per line, then the megabytes of as many categories in use as fit.
+    // 'mem dump' has all of them.
+    long long total = 0;
+    for (int i = 0; i < MEM_CATEGORIES; i++)
+        total += zenHeap.bytes[i];
+    char msg[sizeof(E->statusmsg)];
+    int len = snprintf(msg, sizeof(msg), "%.1f B/line |", (double)total / (E->numrows ? E->numrows : 1));
+    for (int i = 0; i < MEM_CATEGORIES; i++)
+    {
+        if (zenHeap.bytes[i] == 0)
+            continue;
+        char part[32];
+        int n = snprintf(part, sizeof(part), " %s %.1fM", memCategoryNames[i], zenHeap.bytes[i] / 1048576.0);
+        if (len + n >= (int)sizeof(msg) - 4)
+        {
+            snprintf(&msg[len], sizeof(msg) - len, " ...");
+            break;
+        }
+        memcpy(&msg[len], part, n + 1);
+        len += n;
+    }
+    editorSetStatusMessage("%s", msg);
+}
+
+/*** syntax highlighting ***/
+
+/// @brief Takes a character and returns true if it’s considered a separator character.
+int is_separator(int c)
+{
+    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+/// @brief Highlight a single row. Returns whether its multi-line comment state changed, in which case the next row needs highlighting too.
+int editorHighlightRow(erow *row)
+{
+    row->hl = editorRealloc(MEM_HL, row->hl, row->rsize);
+    memset(row->hl, HL_NORMAL, row->rsize);
+    row->hl_valid = 1;
+
+    if (E->syntax == NULL)
+        return 0;
+
+    char **keywords = E->syntax->keywords;
+
+    // Single line and multi line comments.
+    char *scs = E->syntax->singleline_comment_start;
+    char *mcs = E->syntax->multiline_comment_start;
+    char *mce = E->syntax->multiline_comment_end;
+
+    int scs_len = scs ? strlen(scs) : 0;
+    int mcs_len = mcs ? strlen(mcs) : 0;
+    int mce_len = mce ? strlen(mce) : 0;
+
+    // 'prev_sep' keeps track of whether the previous character was a separator.
+    int prev_sep = 1;
+
+    // 'in_string' keeps track of whether we are currently inside a string.
+    int in_string = 0;
+
+    // boolean variable to keep track of whether we’re currently inside a multi-line comment (this variable isn’t used for single-line comments).
+    // we initialize in_comment to true if the previous row has an unclosed multi-line comment. If that’s the case, then the current row will start out being highlighted as a multi-line comment.
+    int in_comment = (row->idx > 0 && E->row[row->idx - 1].hl_open_comment);
+
+    int i = 0;
+    while (i < row->rsize)
+    {
+        char c = row->render[i];
+
+        // 'prev_hl' is set to the highlight type of the previous character.
+        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+
+        if (scs_len && !in_string && !in_comment)
+        {
+            if (!strncmp(&row->render[i], scs, scs_len))
+            {
+                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
+                break;
+            }
+        }
+
+        if (mcs_len && mce_len && !in_string)
+        {
+            if (in_comment)
+            {
+                row->hl[i] = HL_MLCOMMENT;
+                // If comment ends
+                if (!strncmp(&row->render[i], mce, mce_len))
+                {
+                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+                    i += mce_len;
+                    in_comment = 0;
+                    prev_sep = 1;
+                    continue;
+                }
+                else
+                {
+                    i++;
+                    continue;
+                }
+            }
+            else if (!strncmp(&row->render[i], mcs, mcs_len))
+            {
+                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+                i += mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+
+        if (E->syntax->flags & HL_HIGHLIGHT_STRINGS)
+        {
+            if (in_string)
+            {
+                row->hl[i] = HL_STRING;
+
+                if (c == '\\' && i + 1 < row->rsize)
+                {
+                    row->hl[i + 1] = HL_STRING;
+                    i += 2;
+                    continue;
+                }
+
+                if (c == in_string)
+                    in_string = 0;
+
+                i++;
+                prev_sep = 1;
+                continue;
+            }
+            else
+            {
+                if (c == '"' || c == '\'')
+                {
+                    in_string = c;
+                    row->hl[i] = HL_STRING;
+
+                    i++;
+                    continue;
+                }
+            }
+        }
+
+        if (E->syntax->flags & HL_HIGHLIGHT_NUMBERS)
+        {
+            // To highlight a digit with HL_NUMBER, we require the previous character to either be a separator, or to also be highlighted with HL_NUMBER.
+            if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER))
+            {
+                // Increment i to “consume” that character, set prev_sep to 0 to indicate we are in the middle of highlighting something,
+                // and then continue the loop.
+                row->hl[i] = HL_NUMBER;
+                i++;
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        if (prev_sep)
+        {
+            int j;
+            for (j = 0; keywords[j]; j++)
+            {
+                int klen = strlen(keywords[j]);
+                int kw2 = keywords[j][klen - 1] == '|';
+                if (kw2)
+                    klen--;
+
+                if (!strncmp(&row->render[i], keywords[j], klen) && is_separator(row->render[i + klen]))
+                {
+                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+                    i += klen;
+                    break;
+                }
+            }
+            if (keywords[j] != NULL)
+            {
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        prev_sep = is_separator(c);
+        i++;
+    }
+    int changed = (row->hl_open_comment != in_comment);
+    row->hl_open_comment = in_comment; // set the value of the current row’s hl_open_comment to whatever state in_comment got left in after processing the entire row.
+    return changed;
+}
+
+/// @brief Highlight a row, then keep updating the syntax of the next lines in the file for as long as the comment state changes.
+void editorUpdateSyntax(erow *row)
+{
+    uint64_t t = editorPerfNow();
+    // A loop rather than recursion: opening a comment can change the state of every row below it.
+    while (editorHighlightRow(row) && row->idx + 1 < E->numrows)
+        row = &E->row[row->idx + 1];
+    editorPerfEnd(PERF_SYNTAX, t);
+}
+
+/// @brief Highlight rows [lo, hi] in one pass, then continue below hi while the comment state keeps changing.
+void editorHighlightRange(int lo, int hi)
+{
+    if (lo < 0)
+        lo = 0;
+    uint64_t t = editorPerfNow();
+    for (int j = lo; j < E->numrows; j++)
+    {
+        if (!editorHighlightRow(&E->row[j]) && j >= hi)
+            break;
+    }
+    editorPerfEnd(PERF_SYNTAX, t);
+}
+
+/// @brief Group edits: until the matching editorBatchEnd(), edited rows are not highlighted one by one, only once at the end.
+void editorBatchBegin()
+{
+    if (E->defer_syntax++ == 0)
+    {
+        E->batch_lo = E->numrows;
+        E->batch_hi = -1;
+    }
+}
+
+void editorBatchEnd()
+{
+    if (--E->defer_syntax == 0 && E->batch_lo <= E->batch_hi)
+        editorHighlightRange(E->batch_lo, E->batch_hi);
+}
+
+/// @brief Widen the range of rows the current batch must highlight.
+void editorBatchTouch(int at)
+{
+    if (at < E->batch_lo)
+        E->batch_lo = at;
+    if (at > E->batch_hi)
+        E->batch_hi = at;
+}
+
+/// @brief Make sure a row's highlighting has been computed. Rows loaded from the sidecar cache are only highlighted once they are needed.
+void editorRowHighlight(erow *row)
+{
+    // Not hl == NULL: an empty row has no highlighting even once it is highlighted.
+    if (!row->hl_valid)
+        editorUpdateSyntax(row);
+}
+
+int editorSyntaxToColor(int hl)
+{
+    switch (hl)
+    {
+    case HL_MLCOMMENT:
+    case HL_COMMENT:
+        return 36;
+    case HL_KEYWORD1:
+        return 33;
+    case HL_KEYWORD2:
+        return 32;
+    case HL_STRING:
+        return 35;
+    case HL_NUMBER:
+        return 31;
+    case HL_MATCH:
+        return 34;
+    default:
+        return 37;
+    }
+}
+
+/// @brief Function that tries to match the current filename to one of the filematch fields in the HLDB. If one matches, it’ll set E->syntax to that filetype.
+void editorSelectSyntaxHighlight()
+{
+    E->syntax = NULL;
+
+    if (E->filename == NULL)
+        return;
+
+    // strrchr() returns a pointer to the last occurrence of a character in a string
+    char *ext = strrchr(E->filename, '.');
+
+    for (unsigned int j = 0; j < HLDB_ENTRIES; j++)
+    {
+        struct editorSyntax *s = &HLDB[j];
+        unsigned int i = 0;
+        while (s->filematch[i])
+        {
+            int is_ext = (s->filematch[i][0] == '.');
+
+            if ((is_ext && ext && !strcmp(ext, s->filematch[i])) || (!is_ext && strstr(E->filename, s->filematch[i])))
+            {
+                E->syntax = s;
+
+                int filerow;
+                for (filerow = 0; filerow < E->numrows; filerow++)
+                {
+                    editorUpdateSyntax(&E->row[filerow]);
+                }
+
+                return;
+            }
+            i++;
+        }
+    }
+}
+
+/*** row index ***/
+
+/// @brief Allocate an empty node of the row index.
+struct rowIndexNode *rowIndexNodeNew(int leaf)
+{
+    struct rowIndexNode *node = editorMalloc(MEM_INDEX, sizeof(struct rowIndexNode));
+    node->n = 0;
+    node->leaf = leaf;
+    return node;
+}
+
+/// @brief Free a node of the row index and everything below it.
+void rowIndexNodeFree(struct rowIndexNode *node)
+{
+    if (node == NULL)
+        return;
+    if (!node->leaf)
+    {
+        for (int i = 0; i < node->n; i++)
+            rowIndexNodeFree(node->u.in.child[i]);
+    }
+    editorFree(MEM_INDEX, node);
+}
+
+/// @brief Number of entries a node can hold, weights for a leaf and children otherwise.
+int rowIndexNodeCap(struct rowIndexNode *node)
+{
+    return node->leaf ? ROWIDX_LEAF : ROWIDX_FANOUT;
+}
+
+/// @brief Rows under a node, and the sum of their weights in '*sum'.
+int rowIndexNodeRows(struct rowIndexNode *node, long long *sum)
+{
+    int rows = 0;
+    *sum = 0;
+    for (int i = 0; i < node->n; i++)
+    {
+        if (node->leaf)
+        {
+            rows++;
+            *sum += node->u.w[i];
+        }
+        else
+        {
+            rows += node->u.in.rows[i];
+            *sum += node->u.in.sum[i];
+        }
+    }
+    return rows;
+}
+
+/// @brief Copy 'n' entries of 'src' starting at 'from' into 'dst' at 'to'. Both nodes are of the same kind, and the ranges may overlap.
+void rowIndexNodeMove(struct rowIndexNode *dst, int to, struct rowIndexNode *src, int from, int n)
+{
+    if (src->leaf)
+    {
+        memmove(&dst->u.w[to], &src->u.w[from], sizeof(long long) * n);
+        return;
+    }
+    memmove(&dst->u.in.child[to], &src->u.in.child[from], sizeof(struct rowIndexNode *) * n);
+    memmove(&dst->u.in.rows[to], &src->u.in.rows[from], sizeof(int) * n);
+    memmove(&dst->u.in.sum[to], &src->u.in.sum[from], sizeof(long long) * n);
+}
+
+/// @brief Recompute the row count and weight sum that inner node 'node' keeps for its child 'i'.
+void rowIndexNodeRecount(struct rowIndexNode *node, int i)
+{
+    node->u.in.rows[i] = rowIndexNodeRows(node->u.in.child[i], &node->u.in.sum[i]);
+}
+
+/// @brief Put 'child' in inner node 'node' as its child 'i'. The node must have room for it.
+void rowIndexNodeAdd(struct rowIndexNode *node, int i, struct rowIndexNode *child)
+{
+    rowIndexNodeMove(node, i + 1, node, i, node->n - i);
+    node->u.in.child[i] = child;
+    node->n++;
+    rowIndexNodeRecount(node, i);
+}
+
+/// @brief Build the tree over all the rows in O(n), with full leaves.
+void rowIndexRebuild(struct rowIndex *ri)
+{
+    rowIndexNodeFree(ri->root);
+    ri->size = E->numrows;
+    ri->stale = 0;
+
+    int n = (ri->size + ROWIDX_LEAF - 1) / ROWIDX_LEAF;
+    if (n == 0)
+    {
+        ri->root = rowIndexNodeNew(1);
+        return;
+    }
+    struct rowIndexNode **level = editorMalloc(MEM_INDEX, sizeof(struct rowIndexNode *) * n);
+    for (int i = 0; i < n; i++)
+    {
+        level[i] = rowIndexNodeNew(1);
+        for (int j = i * ROWIDX_LEAF; j < ri->size && level[i]->n < ROWIDX_LEAF; j++)
+            level[i]->u.w[level[i]->n++] = ri->weight(&E->row[j]);
+    }
+
+    // Each level up groups the nodes of the level below, until one is left.
+    while (n > 1)
+    {
+        int up = (n + ROWIDX_FANOUT - 1) / ROWIDX_FANOUT;
+        for (int i = 0; i < up; i++)
+        {
+            struct rowIndexNode *node = rowIndexNodeNew(0);
+            for (int j = i * ROWIDX_FANOUT; j < n && node->n < ROWIDX_FANOUT; j++)
+                rowIndexNodeAdd(node, node->n, level[j]);
+            level[i] = node;
+        }
+        n = up;
+    }
+    ri->root = level[0];
+    editorFree(MEM_INDEX, level);
+}
+
+void rowIndexEnsure(struct rowIndex *ri)
+{
+    if (ri->stale || ri->size != E->numrows)
+        rowIndexRebuild(ri);
+}
+
+/// @brief Sum of the weights of rows [0, n).
+long long rowIndexPrefix(struct rowIndex *ri, int n)
+{
+    rowIndexEnsure(ri);
+    if (n > ri->size)
+        n = ri->size;
+
+    long long sum = 0;
+    struct rowIndexNode *node = ri->root;
+    while (!node->leaf)
+    {
+        int i;
+        for (i = 0; i < node->n - 1 && n >= node->u.in.rows[i]; i++)
+        {
+            n -= node->u.in.rows[i];
+            sum += node->u.in.sum[i];
+        }
+        node = node->u.in.child[i];
+    }
+    for (int j = 0; j < n; j++)
+        sum += node->u.w[j];
+    return sum;
+}
+
+/// @brief Add 'delta' to the weight of row 'at'. Ignored while the tree is stale, the next rebuild picks the new weight up.
+void rowIndexUpdate(struct rowIndex *ri, int at, long long delta)
+{
+    if (ri->stale || at < 0 || at >= ri->size)
+        return;
+
+    struct rowIndexNode *node = ri->root;
+    while (!node->leaf)
+    {
+        int i;
+        for (i = 0; i < node->n - 1 && at >= node->u.in.rows[i]; i++)
+            at -= node->u.in.rows[i];
+        node->u.in.sum[i] += delta;
+        node = node->u.in.child[i];
+    }
+    node->u.w[at] += delta;
+}
+
+/// @brief Insert a zero-weight row at 'at' below 'node'. If the node had to be split, returns its new right half, for the caller to add.
+struct rowIndexNode *rowIndexNodeInsert(struct rowIndexNode *node, int at)
+{
+    struct rowIndexNode *child = NULL;
+    int i = at;
+    if (!node->leaf)
+    {
+        for (i = 0; i < node->n - 1 && at > node->u.in.rows[i]; i++)
+            at -= node->u.in.rows[i];
+        child = rowIndexNodeInsert(node->u.in.child[i], at);
+        node->u.in.rows[i]++;
+        if (child == NULL)
+            return NULL;
+        // The child split: it goes on with fewer rows, and its new right half goes in right after it.
+        rowIndexNodeRecount(node, i);
+        i++;
+    }
+
+    // A full node gives its upper half to a new sibling before it takes the new entry.
+    struct rowIndexNode *right = NULL, *dst = node;
+    if (node->n == rowIndexNodeCap(node))
+    {
+        int half = node->n / 2;
+        right = rowIndexNodeNew(node->leaf);
+        rowIndexNodeMove(right, 0, node, half, node->n - half);
+        right->n = node->n - half;
+        node->n = half;
+        if (i > half)
+        {
+            dst = right;
+            i -= half;
+        }
+    }
+    if (dst->leaf)
+    {
+        rowIndexNodeMove(dst, i + 1, dst, i, dst->n - i);
+        dst->u.w[i] = 0;
+        dst->n++;
+    }
+    else
+        rowIndexNodeAdd(dst, i, child);
+    return right;
+}
+
+/// @brief A zero-weight row was inserted at 'at'. O(log n) anywhere in the file.
+void rowIndexInsert(struct rowIndex *ri, int at)
+{
+    if (ri->stale || ri->root == NULL || at < 0 || at > ri->size)
+    {
+        ri->stale = 1;
+        return;
+    }
+
+    struct rowIndexNode *right = rowIndexNodeInsert(ri->root, at);
+    if (right)
+    {
+        // The root split, so the tree grows a level.
+        struct rowIndexNode *root = rowIndexNodeNew(0);
+        rowIndexNodeAdd(root, 0, ri->root);
+        rowIndexNodeAdd(root, 1, right);
+        ri->root = root;
+    }
+    ri->size++;
+}
+
+/// @brief Even out children 'i' and 'i' + 1 of inner node 'node', merging them into one if they fit.
+void rowIndexNodeBalance(struct rowIndexNode *node, int i)
+{
+    struct rowIndexNode *a = node->u.in.child[i], *b = node->u.in.child[i + 1];
+    int total = a->n + b->n;
+    if (total <= rowIndexNodeCap(a))
+    {
+        rowIndexNodeMove(a, a->n, b, 0, b->n);
+        a->n = total;
+        editorFree(MEM_INDEX, b);
+        rowIndexNodeMove(node, i + 1, node, i + 2, node->n - i - 2);
+        node->n--;
+        rowIndexNodeRecount(node, i);
+        return;
+    }
+
+    int half = total / 2;
+    if (a->n < half)
+    {
+        int k = half - a->n;
+        rowIndexNodeMove(a, a->n, b, 0, k);
+        rowIndexNodeMove(b, 0, b, k, b->n - k);
+        a->n += k;
+        b->n -= k;
+    }
+    else
+    {
+        int k = a->n - half;
+        rowIndexNodeMove(b, k, b, 0, b->n);
+        rowIndexNodeMove(b, 0, a, half, k);
+        a->n -= k;
+        b->n += k;
+    }
+    rowIndexNodeRecount(node, i);
+    rowIndexNodeRecount(node, i + 1);
+}
+
+/// @brief Remove row 'at' below 'node', and return the weight it had.
+long long rowIndexNodeDelete(struct rowIndexNode *node, int at)
+{
+    if (node->leaf)
+    {
+        long long w = node->u.w[at];
+        rowIndexNodeMove(node, at, node, at + 1, node->n - at - 1);
+        node->n--;
+        return w;
+    }
+
+    int i;
+    for (i = 0; i < node->n - 1 && at >= node->u.in.rows[i]; i++)
+        at -= node->u.in.rows[i];
+    struct rowIndexNode *child = node->u.in.child[i];
+    long long w = rowIndexNodeDelete(child, at);
+    node->u.in.rows[i]--;
+    node->u.in.sum[i] -= w;
+    // A child left less than half full shares with a neighbour, or merges into it.
+    if (child->n < rowIndexNodeCap(child) / 2 && node->n > 1)
+        rowIndexNodeBalance(node, i < node->n - 1 ? i : i - 1);
+    return w;
+}
+
+/// @brief Row 'at' is about to be removed. O(log n) anywhere in the file.
+void rowIndexDelete(struct rowIndex *ri, int at)
+{
+    if (ri->stale || ri->root == NULL || at < 0 || at >= ri->size)
+    {
+        ri->stale = 1;
+        return;
+    }
+
+    rowIndexNodeDelete(ri->root, at);
+    ri->size--;
+    // A root left with a single child hands over to it, and the tree loses a level.
+    while (!ri->root->leaf && ri->root->n == 1)
+    {
+        struct rowIndexNode *root = ri->root;
+        ri->root = root->u.in.child[0];
+        editorFree(MEM_INDEX, root);
+    }
+}
+
+/// @brief Find the row holding unit 'target' (0-based), and store the offset of 'target' inside that row in '*rem'.
+/// Returns E->numrows if 'target' is past the last row.
+int rowIndexFind(struct rowIndex *ri, long long target, long long *rem)
+{
+    rowIndexEnsure(ri);
+
+    // Descend the tree, skipping every subtree whose weights still fit in 'target'.
+    int pos = 0;
+    struct rowIndexNode *node = ri->root;
+    while (!node->leaf)
+    {
+        int i;
+        for (i = 0; i < node->n - 1 && target >= node->u.in.sum[i]; i++)
+        {
+            target -= node->u.in.sum[i];
+            pos += node->u.in.rows[i];
+        }
+        node = node->u.in.child[i];
+    }
+    int j;
+    for (j = 0; j < node->n && target >= node->u.w[j]; j++)
+        target -= node->u.w[j];
+    if (rem)
+        *rem = target;
+    return pos + j;
+}
+
+/// @brief Free the tree. The index is left stale, to be rebuilt on next use.
+void rowIndexFree(struct rowIndex *ri)
+{
+    rowIndexNodeFree(ri->root);
+    ri->root = NULL;
+    ri->size = 0;
+    ri->stale = 1;
+}
+
+/*** soft wrap ***/
+
+/// @brief Number of screen columns available for the text of a row.
+int editorTextCols()
+{
+    int cols = E->screencols - E->gutter;
+    return cols > 0 ? cols : 1;
+}
+
+/// @brief Lay a row out at the current wrap width and return the number of visual lines it takes.
+/// A row always keeps room for the cursor one past its last character, so a row exactly as wide as the screen takes two lines.
+long long editorRowLayout(erow *row)
+{
+    row->wrapcols = editorTextCols();
+    row->wraps = row->rsize / row->wrapcols + 1;
+    return row->wraps;
+}
+
+/// @brief Visual lines row 'at' takes, laying it out first if the text width changed since it last was.
+/*
+    A resize or a gutter change doesn't lay the whole file out again: rows are laid out when they are visited (drawn, or
+    near the cursor), and the wrap index takes the difference in O(log n). Until then a row keeps its old height, which only
+    makes the visual line numbers of the rows below it approximate. A row above the top of the screen that changes height
+    moves E->rowoff along, so the text on screen stays put.
+*/
+int editorRowWraps(int at)
+{
+    erow *row = &E->row[at];
+    if (row->wrapcols == editorTextCols())
+        return row->wraps;
+
+    int old = row->wraps;
+    int vline = E->wrap ? editorRowToVline(at) : 0;
+    editorRowLayout(row);
+    rowIndexUpdate(&E->wrapidx, at, row->wraps - old);
+    if (E->wrap && vline + old <= E->rowoff)
+        E->rowoff += row->wraps - old;
+    else if (E->wrap && vline <= E->rowoff && E->rowoff >= vline + row->wraps)
+        E->rowoff = vline + row->wraps - 1;
+    return row->wraps;
+}
+
+/// @brief Visual line at which file row 'at' starts.
+int editorRowToVline(int at)
+{
+    return rowIndexPrefix(&E->wrapidx, at);
+}
+
+/// @brief Map a visual line to the file row holding it. '*sub' receives which wrapped line of that row it is.
+int editorVlineToRow(int vline, int *sub)
+{
+    long long rem;
+    int filerow = rowIndexFind(&E->wrapidx, vline, &rem);
+    if (sub)
+        *sub = rem;
+    return filerow;
+}
+
+/// @brief Visual line the cursor is on. Uses E->rx, so call it after editorScroll() has computed it.
+int editorCursorVline()
+{
+    int vline = editorRowToVline(E->cy);
+    if (E->cy < E->numrows)
+        vline += E->rx / editorTextCols();
+    return vline;
+}
+
+/// @brief The text width changed (resize, gutter). Rows are laid out again as they are visited, see editorRowWraps(), so this
+/// only moves the top of the screen to the start of its file row.
+void editorInvalidateLayout()
+{
+    if (E->wrap)
+        E->rowoff = editorRowToVline(editorVlineToRow(E->rowoff, NULL));
+}
+
+void editorToggleWrap()
+{
+    if (E->wrap)
+    {
+        // Turn the visual line at the top of the screen back into a file row.
+        E->rowoff = editorVlineToRow(E->rowoff, NULL);
+        E->wrap = 0;
+    }
+    else
+    {
+        // Rows edited while wrap was off are laid out again when visited, like after a resize.
+        E->wrap = 1;
+        E->rowoff = editorRowToVline(E->rowoff);
+        E->coloff = 0;
+    }
+    editorSetStatusMessage("Soft wrap %s", E->wrap ? "on" : "off");
+}
+
+/*** line numbers ***/
+
+/// @brief Recompute the gutter width, but only when the number of digits in E->numrows changed.
+void editorUpdateGutter()
+{
+    if (!E->linenums)
+        return;
+
+    int n = E->numrows > 0 ? E->numrows : 1;
+    if (n >= E->gutter_min && n < E->gutter_max)
+        return;
+
+    int digits = 1;
+    E->gutter_min = 1;
+    E->gutter_max = 10;
+    while (n >= E->gutter_max)
+    {
+        E->gutter_min = E->gutter_max;
+        E->gutter_max *= 10;
+        digits++;
+    }
+
+    // The text area got narrower or wider, so wrapped rows must be laid out again.
+    E->gutter = digits + 1;
+    editorInvalidateLayout();
+}
+
+void editorToggleLineNumbers()
+{
+    E->linenums = !E->linenums;
+    E->gutter = 0;
+    E->gutter_min = E->gutter_max = 0;
+    if (E->linenums)
+        editorUpdateGutter();
+    else
+        editorInvalidateLayout();
+    editorSetStatusMessage("Line numbers %s", E->linenums ? "on" : "off");
+}
+
+/// @brief Write line number 'n' right-aligned into the gutter buffer 'buf' of E->gutter bytes (the last one is a space).
+void editorFormatLineNumber(char *buf, int n)
+{
+    memset(buf, ' ', E->gutter);
+    int i = E->gutter - 2;
+    do
+    {
+        buf[i--] = '0' + n % 10;
+        n /= 10;
+    } while (n && i >= 0);
+}
+
+/// @brief Add one to the line number in the gutter buffer, carrying like a decimal counter. Cheaper than formatting every row.
+void editorIncrementLineNumber(char *buf)
+{
+    int i = E->gutter - 2;
+    while (i >= 0 && buf[i] == '9')
+        buf[i--] = '0';
+    if (i >= 0)
+        buf[i] = (buf[i] == ' ') ? '1' : buf[i] + 1;
+}
+
+/*** statistics ***/
+
+/// @brief Index of the first entry of E->stats.longlens that is >= len.
+int editorStatsLongSearch(int len)
+{
+    int lo = 0, hi = E->stats.nlonglens;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (E->stats.longlens[mid] < len)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/// @brief Count the words and characters of a row and add them, and its length, to the document statistics.
+void editorStatsAdd(erow *row)
+{
+    int words = 0, nchars = 0, inword = 0;
+    for (int j = 0; j < row->size; j++)
+    {
+        unsigned char c = row->chars[j];
+        // UTF-8 continuation bytes look like 10xxxxxx, every other byte starts a character.
+        if ((c & 0xC0) != 0x80)
+            nchars++;
+        if (isspace(c))
+            inword = 0;
+        else if (!inword)
+        {
+            inword = 1;
+            words++;
+        }
+    }
+    row->words = words;
+    row->nchars = nchars;
+    E->stats.words += words;
+    E->stats.chars += nchars;
+
+    if (row->size < ZEN_STATS_DENSE)
+    {
+        E->stats.lenhist[row->size]++;
+        if (row->size > E->stats.dense_max)
+            E->stats.dense_max = row->size;
+        return;
+    }
+
+    if (E->stats.nlonglens == E->stats.longlens_cap)
+    {
+        E->stats.longlens_cap = E->stats.longlens_cap ? E->stats.longlens_cap * 2 : 16;
+        E->stats.longlens = editorRealloc(MEM_STATS, E->stats.longlens, sizeof(int) * E->stats.longlens_cap);
+    }
+    int at = editorStatsLongSearch(row->size);
+    memmove(&E->stats.longlens[at + 1], &E->stats.longlens[at], sizeof(int) * (E->stats.nlonglens - at));
+    E->stats.longlens[at] = row->size;
+    E->stats.nlonglens++;
+}
+
+/// @brief Take a row's counts back out of the document statistics, before the row is modified or deleted.
+void editorStatsRemove(erow *row)
+{
+    E->stats.words -= row->words;
+    E->stats.chars -= row->nchars;
+
+    if (row->size < ZEN_STATS_DENSE)
+    {
+        E->stats.lenhist[row->size]--;
+        // The longest short row went away: walk down to the next length in use. Bounded by ZEN_STATS_DENSE, never by the number of rows.
+        while (E->stats.dense_max > 0 && E->stats.lenhist[E->stats.dense_max] == 0)
+            E->stats.dense_max--;
+        return;
+    }
+
+    int at = editorStatsLongSearch(row->size);
+    if (at < E->stats.nlonglens && E->stats.longlens[at] == row->size)
+    {
+        memmove(&E->stats.longlens[at], &E->stats.longlens[at + 1], sizeof(int) * (E->stats.nlonglens - at - 1));
+        E->stats.nlonglens--;
+    }
+}
+
+int editorStatsLongest()
+{
+    if (E->stats.nlonglens)
+        return E->stats.longlens[E->stats.nlonglens - 1];
+    return E->stats.dense_max;
+}
+
+void editorToggleStatsPanel()
+{
+    E->stats_panel = !E->stats_panel;
+}
+
+/*** clipboard ***/
+
+/// @brief The lines of the clipboard text, pointing into the rows while the clipboard is live. The array must be freed, with editorFree(MEM_CLIPBOARD), not the lines.
+struct clipLine *editorClipboardSpans(int *n)
+{
+    if (!zenClipboard.live)
+    {
+        *n = zenClipboard.nlines;
+        struct clipLine *lines = editorMalloc(MEM_CLIPBOARD, sizeof(struct clipLine) * (zenClipboard.nlines ? zenClipboard.nlines : 1));
+        memcpy(lines, zenClipboard.lines, sizeof(struct clipLine) * zenClipboard.nlines);
+        return lines;
+    }
+
+    *n = zenClipboard.r2 - zenClipboard.r1 + 1;
+    struct clipLine *lines = editorMalloc(MEM_CLIPBOARD, sizeof(struct clipLine) * *n);
+    for (int j = zenClipboard.r1; j <= zenClipboard.r2; j++)
+    {
+        erow *row = &E->row[j];
+        int from = (j == zenClipboard.r1) ? zenClipboard.c1 : 0;
+        int to = (j == zenClipboard.r2) ? zenClipboard.c2 : row->size;
+        lines[j - zenClipboard.r1].s = &row->chars[from];
+        lines[j - zenClipboard.r1].len = to - from;
+    }
+    return lines;
+}
+
+/// @brief Drop the clipboard text.
+void editorClipboardClear()
+{
+    if (!zenClipboard.live)
+    {
+        for (int j = 0; j < zenClipboard.nlines; j++)
+            editorFree(MEM_CLIPBOARD, zenClipboard.lines[j].s);
+        editorFree(MEM_CLIPBOARD, zenClipboard.lines);
+    }
+    memset(&zenClipboard, 0, sizeof(zenClipboard));
+}
+
+/// @brief Give the clipboard its own copy of the text it refers to.
+void editorClipboardMaterialize()
+{
+    if (!zenClipboard.live)
+        return;
+
+    int n;
+    struct clipLine *lines = editorClipboardSpans(&n);
+    for (int j = 0; j < n; j++)
+    {
+        char *copy = editorMalloc(MEM_CLIPBOARD, lines[j].len + 1);
+        memcpy(copy, lines[j].s, lines[j].len);
+        copy[lines[j].len] = '\0';
+        lines[j].s = copy;
+    }
+    zenClipboard.live = 0;
+    zenClipboard.lines = lines;
+    zenClipboard.nlines = n;
+}
+
+/// @brief Rows [lo, hi] are about to change or move: materialize the clipboard first if it refers to any of them.
+void editorClipboardProtectRows(int lo, int hi)
+{
+    if (zenClipboard.live && hi >= zenClipboard.r1 && lo <= zenClipboard.r2)
+        editorClipboardMaterialize();
+}
+
+/// @brief Row 'at' is about to change.
+void editorClipboardProtect(int at)
+{
+    editorClipboardProtectRows(at, at);
+}
+
+/// @brief 'n' rows are about to be inserted at 'at' (n > 0), or removed from 'at' (n < 0). Rows above the clipboard span shift it.
+void editorClipboardRowsMoved(int at, int n)
+{
+    if (!zenClipboard.live)
+        return;
+
+    int before = (n > 0) ? at <= zenClipboard.r1 : at - n <= zenClipboard.r1;
+    if (before)
+    {
+        zenClipboard.r1 += n;
+        zenClipboard.r2 += n;
+    }
+    else if (at <= zenClipboard.r2)
+    {
+        // Rows inserted inside the span, or some of its rows removed.
+        editorClipboardMaterialize();
+    }
+}
+
+/*** row operations ***/
+
+/// @brief Bytes a row takes in the file, including its line ending. Weight of E->byteidx.
+long long editorRowBytes(erow *row)
+{
+    return row->size + 1 + row->crlf;
+}
+
+/// @brief Keep the byte index and file size in sync after a row grew or shrank by 'delta' bytes.
+void editorRowResized(erow *row, int delta)
+{
+    E->totalbytes += delta;
+    rowIndexUpdate(&E->byteidx, row->idx, delta);
+}
+
+/// @brief Give a row read from the file its line ending. The ending of the first row is used for new rows.
+void editorRowSetEnding(erow *row, int crlf)
+{
+    editorRowResized(row, crlf - row->crlf);
+    row->crlf = crlf;
+    if (row->idx == 0)
+        E->crlf = crlf;
+}
+
+/// @brief Offset of position (cy, cx) from the start of the file, in bytes.
+long long editorOffset(int cy, int cx)
+{
+    return rowIndexPrefix(&E->byteidx, cy) + cx;
+}
+
+/// @brief Offset of the cursor from the start of the file, in bytes.
+long long editorCursorOffset()
+{
+    return editorOffset(E->cy, E->cx);
+}
+
+/// @brief Converts a chars index into a render index.
+int editorRowCxToRx(erow *row, int cx)
+{
+    int rx = 0;
+    int j;
+
+    for (j = 0; j < cx; j++)
+    {
+        if (row->chars[j] == '\t')
+        {
+            /*
+                For each character, if it’s a tab we use rx % ZEN_TAB_STOP to find out how many columns we are to the right of the last tab stop,
+                and then subtract that from ZEN_TAB_STOP - 1 to find out how many columns we are to the left of the next tab stop.
+                We add that amount to rx to get just to the left of the next tab stop, and then the unconditional rx++ statement gets us right on the next tab stop.
+            */
+            rx += (ZEN_TAB_STOP - 1) - (rx % ZEN_TAB_STOP);
+        }
+        rx++;
+    }
+
+    return rx;
+}
+
+int editorRowRxToCx(erow *row, int rx)
+{
+    int cur_rx = 0;
+    int cx;
+    for (cx = 0; cx < row->size; cx++)
+    {
+        if (row->chars[cx] == '\t')
+            cur_rx += (ZEN_TAB_STOP - 1) - (cur_rx % ZEN_TAB_STOP);
+        cur_rx++;
+        if (cur_rx > rx)
+            return cx;
+    }
+    return cx;
+}
+
+/// @brief Uses the chars string of an erow to fill in the contents of the render string.
+/// @param row
+void editorUpdateRow(erow *row)
+{
+    uint64_t t = editorPerfNow();
+
+    // Count number of tabs used in line as we will render spaces instead of tabs.
+    // Because tabs just shift the cursor.
+    int tabs = 0;
+    int j;
+    for (j = 0; j < row->size; j++)
+    {
+        if (row->chars[j] == '\t')
+            tabs++;
+    }
+
+    // Allocate memory to render.
+    editorFree(MEM_RENDER, row->render);
+    row->render = editorMalloc(MEM_RENDER, row->size + tabs * (ZEN_TAB_STOP - 1) + 1);
+    int idx = 0;
+
+    for (j = 0; j < row->size; j++)
+    {
+        // If we encounter tab
+        if (row->chars[j] == '\t')
+        {
+            // Maximum number of characters needed for each tab is ZEN_TAB_STOP.
+            row->render[idx++] = ' ';
+            while (idx % ZEN_TAB_STOP != 0)
+                row->render[idx++] = ' ';
+        }
+        else
+        {
+            row->render[idx++] = row->chars[j];
+        }
+    }
+    row->render[idx] = '\0';
+    row->rsize = idx;
+
+    if (E->wrap)
+    {
+        int old = row->wraps;
+        if (editorRowLayout(row) != old)
+            rowIndexUpdate(&E->wrapidx, row->idx, row->wraps - old);
+    }
+    else
+        row->wrapcols = 0;
+    editorPerfEnd(PERF_UPDATE_ROW, t);
+
+    if (E->defer_syntax)
+    {
+        // The old highlighting no longer matches render. editorBatchEnd(), or editorRowHighlight() when the row is drawn, computes it.
+        editorFree(MEM_HL, row->hl);
+        row->hl = NULL;
+        row->hl_valid = 0;
+        editorBatchTouch(row->idx);
+        return;
+    }
+    editorUpdateSyntax(row);
+}
+
+/// @brief Allocate space for a new erow, and then copy the given string to a new erow at the end of the E->row array. Insert a row at the index specified by the new at argument.
+void editorInsertRow(int at, char *s, size_t len)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at > E->numrows)
+        return;
+
+    editorClipboardRowsMoved(at, 1);
+    E->row = editorRealloc(MEM_ROWS, E->row, sizeof(erow) * (E->numrows + 1));
+    memmove(&E->row[at + 1], &E->row[at], sizeof(erow) * (E->numrows - at));
+    // update the idx of each row whenever a row is inserted into the file.
+    for (int j = at + 1; j <= E->numrows; j++)
+    {
+        E->row[j].idx++;
+    }
+
+    E->row[at].idx = at;
+    if (E->defer_syntax && at <= E->batch_hi)
+        E->batch_hi++;
+
+    E->row[at].size = len;
+    E->row[at].chars = editorMalloc(MEM_CHARS, len + 1);
+    memcpy(E->row[at].chars, s, len);
+    E->row[at].chars[len] = '\0';
+
+    E->row[at].rsize = 0;
+    E->row[at].render = NULL;
+    E->row[at].hl = NULL;
+    E->row[at].hl_valid = 0;
+    E->row[at].hl_open_comment = 0;
+    E->row[at].wraps = 0;
+    E->row[at].wrapcols = 0;
+    E->row[at].crlf = E->crlf;
+    editorStatsAdd(&E->row[at]);
+    rowIndexInsert(&E->wrapidx, at);
+    rowIndexInsert(&E->byteidx, at);
+    editorRowResized(&E->row[at], editorRowBytes(&E->row[at]));
+    editorUpdateRow(&E->row[at]);
+
+    E->numrows++;
+    E->dirty++;
+    editorUpdateGutter();
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Freeing the memory owned by the erow.
+void editorFreeRow(erow *row)
+{
+    editorFree(MEM_RENDER, row->render);
+    editorFree(MEM_CHARS, row->chars);
+    editorFree(MEM_HL, row->hl);
+}
+
+void editorDelRow(int at)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at >= E->numrows)
+        return;
+
+    editorClipboardRowsMoved(at, -1);
+    rowIndexDelete(&E->wrapidx, at);
+    rowIndexDelete(&E->byteidx, at);
+    E->totalbytes -= editorRowBytes(&E->row[at]);
+    editorStatsRemove(&E->row[at]);
+    editorFreeRow(&E->row[at]);
+    memmove(&E->row[at], &E->row[at + 1], sizeof(erow) * (E->numrows - at - 1));
+    // update the idx of each row whenever a row is removed from the file.
+    for (int j = at; j < E->numrows - 1; j++)
+    {
+        E->row[j].idx--;
+    }
+
+    E->numrows--;
+    E->dirty++;
+    editorUpdateGutter();
+
+    // The row below takes over the deleted row's place, and must be highlighted with the state of the row above.
+    if (E->defer_syntax)
+    {
+        if (at <= E->batch_hi)
+            E->batch_hi--;
+        editorBatchTouch(at < E->numrows ? at : at - 1);
+    }
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Insert 'n' rows at 'at' with a single move of the row array, instead of 'n' calls to editorInsertRow().
+void editorInsertRows(int at, const struct clipLine *lines, int n)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at > E->numrows || n <= 0)
+        return;
+
+    editorClipboardRowsMoved(at, n);
+    E->row = editorRealloc(MEM_ROWS, E->row, sizeof(erow) * (E->numrows + n));
+    memmove(&E->row[at + n], &E->row[at], sizeof(erow) * (E->numrows - at));
+    for (int j = at + n; j < E->numrows + n; j++)
+        E->row[j].idx += n;
+    if (E->defer_syntax && at <= E->batch_hi)
+        E->batch_hi += n;
+
+    E->numrows += n;
+
+    // The new rows are highlighted together at the end: a comment opened in one of them must not run on into rows below it
+    // that are not set up yet.
+    editorBatchBegin();
+    for (int i = 0; i < n; i++)
+    {
+        erow *row = &E->row[at + i];
+        row->idx = at + i;
+        row->size = lines[i].len;
+        row->chars = editorMalloc(MEM_CHARS, lines[i].len + 1);
+        memcpy(row->chars, lines[i].s, lines[i].len);
+        row->chars[lines[i].len] = '\0';
+        row->rsize = 0;
+        row->render = NULL;
+        row->hl = NULL;
+        row->hl_valid = 0;
+        row->hl_open_comment = 0;
+        row->wraps = 0;
+        row->wrapcols = 0;
+        row->crlf = E->crlf;
+        rowIndexInsert(&E->wrapidx, at + i);
+        rowIndexInsert(&E->byteidx, at + i);
+        editorRowResized(row, editorRowBytes(row));
+        editorStatsAdd(row);
+        editorUpdateRow(row);
+    }
+    editorBatchEnd();
+
+    E->dirty++;
+    editorUpdateGutter();
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Delete rows [at, at + n) with a single move of the row array.
+void editorDelRows(int at, int n)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at >= E->numrows || n <= 0)
+        return;
+    if (n > E->numrows - at)
+        n = E->numrows - at;
+
+    editorClipboardRowsMoved(at, -n);
+    for (int j = at; j < at + n; j++)
+    {
+        E->totalbytes -= editorRowBytes(&E->row[j]);
+        editorStatsRemove(&E->row[j]);
+        editorFreeRow(&E->row[j]);
+    }
+    memmove(&E->row[at], &E->row[at + n], sizeof(erow) * (E->numrows - at - n));
+    for (int j = at; j < E->numrows - n; j++)
+        E->row[j].idx -= n;
+
+    // Removing most of the file is cheaper as one rebuild of the row indexes than as a removal per row.
+    if (n > E->numrows / 4)
+    {
+        E->wrapidx.stale = 1;
+        E->byteidx.stale = 1;
+    }
+    for (int j = 0; j < n; j++)
+    {
+        rowIndexDelete(&E->wrapidx, at);
+        rowIndexDelete(&E->byteidx, at);
+    }
+    E->numrows -= n;
+    E->dirty++;
+    editorUpdateGutter();
+
+    if (E->defer_syntax)
+    {
+        if (E->batch_hi >= at + n)
+            E->batch_hi -= n;
+        else if (E->batch_hi >= at)
+            E->batch_hi = at - 1;
+        editorBatchTouch(at < E->numrows ? at : at - 1);
+    }
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Append a string to an editor row.
+/// @param row Row to which the string needs to be appended.
+/// @param s String to append.
+/// @param len Size of the string to append.
+void editorRowAppendString(erow *row, char *s, size_t len)
+{
+    uint64_t t = editorPerfNow();
+    editorClipboardProtect(row->idx);
+    editorStatsRemove(row);
+
+    // The row’s new size is row->size + len + 1 (including the null byte).
+    row->chars = editorRealloc(MEM_CHARS, row->chars, row->size + len + 1);
+    memcpy(&row->chars[row->size], s, len);
+
+    row->size += len;
+    editorRowResized(row, len);
+
+    row->chars[row->size] = '\0';
+    editorStatsAdd(row);
+
+    editorUpdateRow(row);
+    E->dirty++;
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+void editorRowInsertChar(erow *row, int at, int c)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at > row->size)
+        at = row->size;
+
+    editorClipboardProtect(row->idx);
+    editorStatsRemove(row);
+    row->chars = editorRealloc(MEM_CHARS, row->chars, row->size + 2);
+    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+
+    row->size++;
+    editorRowResized(row, 1);
+
+    row->chars[at] = c;
+    editorStatsAdd(row);
+    editorUpdateRow(row);
+
+    E->dirty++;
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+void editorRowDelChar(erow *row, int at)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at >= row->size)
+        return;
+
+    editorClipboardProtect(row->idx);
+    editorStatsRemove(row);
+    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
+
+    row->size--;
+    editorRowResized(row, -1);
+    editorStatsAdd(row);
+
+    editorUpdateRow(row);
+
+    E->dirty++;
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Insert 'len' bytes of 's' into a row at 'at', with a single update of the row.
+void editorRowInsertString(erow *row, int at, const char *s, size_t len)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at > row->size)
+        at = row->size;
+
+    editorClipboardProtect(row->idx);
+    editorStatsRemove(row);
+    row->chars = editorRealloc(MEM_CHARS, row->chars, row->size + len + 1);
+    memmove(&row->chars[at + len], &row->chars[at], row->size - at + 1);
+    memcpy(&row->chars[at], s, len);
+
+    row->size += len;
+    editorRowResized(row, len);
+    editorStatsAdd(row);
+    editorUpdateRow(row);
+
+    E->dirty++;
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Delete 'len' bytes of a row starting at 'at', with a single update of the row.
+void editorRowDelString(erow *row, int at, int len)
+{
+    uint64_t t = editorPerfNow();
+    if (at < 0 || at >= row->size || len <= 0)
+        return;
+    if (len > row->size - at)
+        len = row->size - at;
+
+    editorClipboardProtect(row->idx);
+    editorStatsRemove(row);
+    memmove(&row->chars[at], &row->chars[at + len], row->size - at - len + 1);
+
+    row->size -= len;
+    editorRowResized(row, -len);
+    editorStatsAdd(row);
+    editorUpdateRow(row);
+
+    E->dirty++;
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Replace bytes [from, to) of a row with 'len' bytes of 's', with a single update of the row.
+void editorRowReplace(erow *row, int from, int to, const char *s, int len)
+{
+    uint64_t t = editorPerfNow();
+    if (to > row->size)
+        to = row->size;
+    if (from > to)
+        from = to;
+
+    editorClipboardProtect(row->idx);
+    editorStatsRemove(row);
+    int delta = len - (to - from);
+    if (delta > 0)
+        row->chars = editorRealloc(MEM_CHARS, row->chars, row->size + delta + 1);
+    memmove(&row->chars[to + delta], &row->chars[to], row->size - to + 1);
+    memcpy(&row->chars[from], s, len);
+
+    row->size += delta;
+    editorRowResized(row, delta);
+    editorStatsAdd(row);
+    editorUpdateRow(row);
+
+    E->dirty++;
+    editorPerfSpan(PERF_EDIT, __func__, t);
+}
+
+/// @brief Split row 'at' in two at chars index 'col': the part right of 'col' moves to a new row below.
+void editorRowSplit(int at, int col)
+{
+    // If we’re at the beginning of a line, all we have to do is insert a new blank row before the line we’re on.
+    if (col == 0)
+    {
+        editorInsertRow(at, "", 0);
+        return;
+    }
+
+    // First we call editorInsertRow() and pass it the characters on the current row that are to the right of the cursor.
+    erow *row = &E->row[at];
+    editorInsertRow(at + 1, &row->chars[col], row->size - col);
+
+    row = &E->row[at];
+
+    // Then we truncate the current row’s contents by setting its size to the position of the cursor, and we call editorUpdateRow() on the truncated row.
+    editorClipboardProtect(at);
+    editorStatsRemove(row);
+    editorRowResized(row, col - row->size);
+    row->size = col;
+    row->chars[row->size] = '\0';
+    editorStatsAdd(row);
+    editorUpdateRow(row);
+}
+
+/*** editor operations ***/
+
+void editorInsertChar(int c)
+{
+    if (E->cy == E->numrows)
+    {
+        editorInsertRow(E->numrows, "", 0);
+    }
+    editorRowInsertChar(&E->row[E->cy], E->cx, c); // Insert the character at the cursor position.
+    E->cx++;
+}
+
+void editorInsertNewline()
+{
+    editorRowSplit(E->cy, E->cx);
+    E->cy++;
+    E->cx = 0;
+}
+
+/// @brief Insert text, which may contain newlines, at (at, col). The position just after the inserted text is stored back into '*at' and '*col'.
+void editorInsertText(int *at, int *col, const char *s, size_t len)
+{
+    while (1)
+    {
+        if (*at == E->numrows)
+            editorInsertRow(E->numrows, "", 0);
+        if (*col > E->row[*at].size)
+            *col = E->row[*at].size;
+
+        const char *nl = memchr(s, '\n', len);
+        size_t seg = nl ? (size_t)(nl - s) : len;
+        editorRowInsertString(&E->row[*at], *col, s, seg);
+        *col += seg;
+        if (!nl)
+            return;
+
+        editorRowSplit(*at, *col);
+        (*at)++;
+        *col = 0;
+        s += seg + 1;
+        len -= seg + 1;
+    }
+}
+
+/// @brief Delete the text from (r1, c1) up to, but not including, (r2, c2).
+void editorDeleteText(int r1, int c1, int r2, int c2)
+{
+    if (r1 >= E->numrows || r2 < r1 || (r1 == r2 && c2 <= c1))
+        return;
+    if (r2 >= E->numrows)
+    {
+        r2 = E->numrows - 1;
+        c2 = E->row[r2].size;
+    }
+
+    if (r1 == r2)
+    {
+        editorRowDelString(&E->row[r1], c1, c2 - c1);
+        return;
+    }
+
+    // Cut the first row at c1 and glue the rest of the last row onto it, then drop the rows in between.
+    erow *last = &E->row[r2];
+    if (c2 > last->size)
+        c2 = last->size;
+    editorRowDelString(&E->row[r1], c1, E->row[r1].size - c1);
+    editorRowAppendString(&E->row[r1], &last->chars[c2], last->size - c2);
+    editorDelRows(r1 + 1, r2 - r1);
+}
+
+void editorDelChar()
+{
+    if (E->cy == E->numrows)
+        return;
+
+    if (E->cx == 0 && E->cy == 0)
+        return;
+
+    erow *row = &E->row[E->cy];
+    if (E->cx > 0)
+    {
+        editorRowDelChar(row, E->cx - 1);
+        E->cx--;
+    }
+    // If cursor at start of the row, append the rest of the string in row in the previos row.
+    else
+    {
+        E->cx = E->row[E->cy - 1].size;
+        editorRowAppendString(&E->row[E->cy - 1], row->chars, row->size);
+        editorDelRow(E->cy); // delete the row that E->cy
+        E->cy--;
+    }
+}
+
+/*** multiple cursors ***/
+
+/// @brief qsort() comparator ordering cursors by row, then column.
+int editorCursorCompareValues(const void *a, const void *b)
+{
+    const struct editorCursor *x = a;
+    const struct editorCursor *y = b;
+    if (x->cy != y->cy)
+        return x->cy < y->cy ? -1 : 1;
+    return (x->cx > y->cx) - (x->cx < y->cx);
+}
+
+/// @brief Same order, for an array of pointers to cursors.
+int editorCursorCompare(const void *a, const void *b)
+{
+    return editorCursorCompareValues(*(struct editorCursor *const *)a, *(struct editorCursor *const *)b);
+}
+
+/// @brief Add an extra cursor unless one (or the primary cursor) is already there.
+void editorCursorAdd(int cy, int cx)
+{
+    if (cy == E->cy && cx == E->cx)
+        return;
+
+    struct editorCursor cur = {cx, cy};
+    int lo = 0, hi = E->ncursors;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (editorCursorCompareValues(&E->cursors[mid], &cur) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < E->ncursors && !editorCursorCompareValues(&E->cursors[lo], &cur))
+        return;
+
+    if (E->ncursors == E->cursors_cap)
+    {
+        E->cursors_cap = E->cursors_cap ? E->cursors_cap * 2 : 16;
+        E->cursors = realloc(E->cursors, sizeof(struct editorCursor) * E->cursors_cap);
+    }
+    memmove(&E->cursors[lo + 1], &E->cursors[lo], sizeof(struct editorCursor) * (E->ncursors - lo));
+    E->cursors[lo] = cur;
+    E->ncursors++;
+}
+
+void editorCursorsClear()
+{
+    E->ncursors = 0;
+}
+
+/// @brief Add a cursor at the next occurrence of the word under the cursor, after the last cursor added.
+void editorCursorAddNextMatch()
+{
+    if (E->cy >= E->numrows)
+        return;
+
+    // The word around the primary cursor.
+    erow *row = &E->row[E->cy];
+    int start = E->cx, end = E->cx;
+    while (start > 0 && !is_separator(row->chars[start - 1]))
+        start--;
+    while (end < row->size && !is_separator(row->chars[end]))
+        end++;
+    if (start == end)
+    {
+        editorSetStatusMessage("No word under the cursor");
+        return;
+    }
+    char *word = strndup(&row->chars[start], end - start);
+    int offset = E->cx - start;
+
+    // Continue from the last cursor after the primary one, wrapping around the end of the file.
+    int cy = E->cy, from = start + 1;
+    if (E->ncursors)
+    {
+        struct editorCursor *last = &E->cursors[E->ncursors - 1];
+        if (last->cy > E->cy || (last->cy == E->cy && last->cx > E->cx))
+        {
+            cy = last->cy;
+            from = last->cx - offset + 1;
+        }
+    }
+
+    for (int i = 0; i <= E->numrows; i++, cy = (cy + 1) % E->numrows, from = 0)
+    {
+        erow *r = &E->row[cy];
+        if (from < 0)
+            from = 0;
+        if (from > r->size)
+            continue;
+        char *match = strstr(&r->chars[from], word);
+        if (match == NULL)
+            continue;
+
+        int cx = match - r->chars;
+        if (cy == E->cy && cx == start)
+            break; // Back at the primary cursor's word: every occurrence has a cursor.
+        editorCursorAdd(cy, cx + offset);
+        editorSetStatusMessage("%d cursors", E->ncursors + 1);
+        free(word);
+        return;
+    }
+    editorSetStatusMessage("No more matches for '%s'", word);
+    free(word);
+}
+
+/// @brief Add a cursor on every line from the cursor down (or up) to row 'target', at the cursor's screen column.
+void editorCursorAddLines(int target)
+{
+    if (target < 0 || target >= E->numrows || E->cy >= E->numrows)
+        return;
+
+    int rx = editorRowCxToRx(&E->row[E->cy], E->cx);
+    int step = target > E->cy ? 1 : -1;
+    for (int y = E->cy + step; y != target + step; y += step)
+        editorCursorAdd(y, editorRowRxToCx(&E->row[y], rx));
+    editorSetStatusMessage("%d cursors", E->ncursors + 1);
+}
+
+/// @brief Apply a typed character, BACKSPACE or DEL_KEY at every cursor.
+/*
+    The cursors are sorted, so all the cursors of a row are handled together: the row is rebuilt in a single pass that copies
+    the text between consecutive cursors, and gets one editorUpdateRow(). The whole keystroke is one batch, so the rows are
+    highlighted once at the end. Deletions only work inside rows, they never join rows while there are several cursors.
+*/
+void editorMultiEdit(int c)
+{
+    int n = E->ncursors + 1;
+    struct editorCursor *all = malloc(sizeof(struct editorCursor) * n);
+    struct editorCursor **order = malloc(sizeof(struct editorCursor *) * n);
+    all[0].cx = E->cx;
+    all[0].cy = E->cy;
+    memcpy(&all[1], E->cursors, sizeof(struct editorCursor) * E->ncursors);
+    for (int i = 0; i < n; i++)
+        order[i] = &all[i];
+    qsort(order, n, sizeof(*order), editorCursorCompare);
+
+    editorBatchBegin();
+    int insert = (c != BACKSPACE && c != DEL_KEY);
+    if (insert && order[n - 1]->cy == E->numrows)
+        editorInsertRow(E->numrows, "", 0);
+
+    int i = 0;
+    while (i < n)
+    {
+        int cy = order[i]->cy;
+        int j = i;
+        while (j < n && order[j]->cy == cy)
+            j++;
+        if (cy >= E->numrows)
+            break;
+
+        erow *row = &E->row[cy];
+        char *chars = editorMalloc(MEM_CHARS, row->size + (j - i) + 1);
+        int src = 0, dst = 0;
+        for (int k = i; k < j; k++)
+        {
+            int p = order[k]->cx < row->size ? order[k]->cx : row->size;
+            if (insert)
+            {
+                memcpy(&chars[dst], &row->chars[src], p - src);
+                dst += p - src;
+                chars[dst++] = c;
+                src = p;
+            }
+            else if (c == BACKSPACE && p > src)
+            {
+                // Copy up to the character before the cursor and skip it. A cursor right after the previous one finds that character already gone.
+                memcpy(&chars[dst], &row->chars[src], p - 1 - src);
+                dst += p - 1 - src;
+                src = p;
+            }
+            else if (c == DEL_KEY && p >= src && p < row->size)
+            {
+                memcpy(&chars[dst], &row->chars[src], p - src);
+                dst += p - src;
+                src = p + 1;
+            }
+            order[k]->cx = p < src ? dst : dst + (p - src);
+        }
+        memcpy(&chars[dst], &row->chars[src], row->size - src);
+        dst += row->size - src;
+        chars[dst] = '\0';
+
+        if (dst != row->size)
+        {
+            editorClipboardProtect(cy);
+            editorStatsRemove(row);
+            editorRowResized(row, dst - row->size);
+            editorFree(MEM_CHARS, row->chars);
+            row->chars = chars;
+            row->size = dst;
+            editorStatsAdd(row);
+            editorUpdateRow(row);
+            E->dirty++;
+        }
+        else
+            editorFree(MEM_CHARS, chars);
+        i = j;
+    }
+    editorBatchEnd();
+
+    // Write the cursors back in order, merging the ones that ended up in the same place.
+    E->cx = all[0].cx;
+    E->cy = all[0].cy;
+    E->ncursors = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (order[i] != &all[0] && (i == 0 || editorCursorCompare(&order[i], &order[i - 1])) &&
+            (order[i]->cx != E->cx || order[i]->cy != E->cy))
+            E->cursors[E->ncursors++] = *order[i];
+    }
+    free(order);
+    free(all);
+}
+
+/// @brief Move every cursor with Left, Right, Home or End. Cursors stay on their row.
+void editorMultiMove(int key)
+{
+    for (int i = -1; i < E->ncursors; i++)
+    {
+        int *cx = i < 0 ? &E->cx : &E->cursors[i].cx;
+        int cy = i < 0 ? E->cy : E->cursors[i].cy;
+        int size = cy < E->numrows ? E->row[cy].size : 0;
+        if (key == ARROW_LEFT && *cx > 0)
+            (*cx)--;
+        else if (key == ARROW_RIGHT && *cx < size)
+            (*cx)++;
+        else if (key == HOME_KEY)
+            *cx = 0;
+        else if (key == END_KEY)
+            *cx = size;
+    }
+    qsort(E->cursors, E->ncursors, sizeof(struct editorCursor), editorCursorCompareValues);
+}
+
+/// @brief Handle the keys that act on every cursor. Returns 0 for the keys that only concern the primary cursor.
+int editorMultiKeypress(int c)
+{
+    switch (c)
+    {
+    case BACKSPACE:
+    case CTRL_KEY('h'):
+        editorMultiEdit(BACKSPACE);
+        return 1;
+    case DEL_KEY:
+        editorMultiEdit(DEL_KEY);
+        return 1;
+    case ARROW_LEFT:
+    case ARROW_RIGHT:
+    case HOME_KEY:
+    case END_KEY:
+        editorMultiMove(c);
+        return 1;
+    case '\x1b':
+        editorCursorsClear();
+        E->sel_active = 0;
+        return 1;
+    case '\r':
+        // Splitting rows would move every cursor below: go back to a single cursor first.
+        editorCursorsClear();
+        return 0;
+    }
+    if (c == '\t' || (c >= 32 && c < 127))
+    {
+        editorMultiEdit(c);
+        return 1;
+    }
+    return 0;
+}
+
+/*** selection ***/
+
+/// @brief Set the selection anchor at the cursor, or drop the selection.
+void editorSelectionToggle()
+{
+    E->sel_active = !E->sel_active;
+    E->sel_block = 0;
+    E->sel_cy = E->cy;
+    E->sel_cx = E->cx;
+    editorSetStatusMessage(E->sel_active ? "Mark set" : "Mark cleared");
+}
+
+/// @brief Set a block selection anchor at the cursor, or drop the selection.
+void editorBlockToggle()
+{
+    E->sel_active = !E->sel_active;
+    E->sel_block = 1;
+    E->sel_cy = E->cy;
+    E->sel_cx = E->cx;
+    editorSetStatusMessage(E->sel_active ? "Block mark set" : "Mark cleared");
+}
+
+/// @brief Render column of chars index 'cx' of row 'at', or 0 past the last row.
+int editorColumnAt(int at, int cx)
+{
+    return at < E->numrows ? editorRowCxToRx(&E->row[at], cx) : 0;
+}
+
+/// @brief Get the block selection as rows [*y1, *y2] and render columns [*rx1, *rx2). Returns 0 when there is no block.
+int editorBlockBounds(int *y1, int *y2, int *rx1, int *rx2)
+{
+    if (!E->sel_active || !E->sel_block || E->numrows == 0)
+        return 0;
+
+    int ay = E->sel_cy < E->numrows ? E->sel_cy : E->numrows - 1;
+    int cy = E->cy < E->numrows ? E->cy : E->numrows - 1;
+    int arx = editorColumnAt(ay, ay == E->sel_cy && E->sel_cx <= E->row[ay].size ? E->sel_cx : E->row[ay].size);
+    int crx = editorColumnAt(cy, cy == E->cy ? E->cx : E->row[cy].size);
+
+    *y1 = ay < cy ? ay : cy;
+    *y2 = ay < cy ? cy : ay;
+    *rx1 = arx < crx ? arx : crx;
+    *rx2 = arx < crx ? crx : arx;
+    return 1;
+}
+
+/// @brief After a block edit, put the cursor and the anchor back on their rows at render column 'rx'.
+void editorBlockMoveTo(int rx)
+{
+    if (E->cy < E->numrows)
+        E->cx = editorRowRxToCx(&E->row[E->cy], rx);
+    if (E->sel_cy < E->numrows)
+        E->sel_cx = editorRowRxToCx(&E->row[E->sel_cy], rx);
+}
+
+/// @brief Apply a typed character, BACKSPACE or DEL_KEY to every row of the block selection.
+/*
+    A non-empty block is deleted first, whatever the key. An empty block (anchor and cursor in the same column) is a column
+    cursor: Backspace and Delete remove one character on each row, typing inserts on each row long enough to reach the column.
+    Each row is changed with one editorRowReplace(), and the batch highlights the block's rows in one pass at the end.
+*/
+void editorBlockEdit(int c)
+{
+    int y1, y2, rx1, rx2;
+    if (!editorBlockBounds(&y1, &y2, &rx1, &rx2))
+        return;
+
+    int insert = (c != BACKSPACE && c != DEL_KEY);
+    char ch = c;
+    int newrx = rx1;
+    if (rx1 == rx2 && c == BACKSPACE && rx1 > 0)
+        newrx = rx1 - 1;
+    if (insert)
+        newrx = rx1 + 1;
+
+    editorBatchBegin();
+    for (int y = y1; y <= y2; y++)
+    {
+        erow *row = &E->row[y];
+        if (row->rsize < rx1)
+            continue;
+
+        int x1 = editorRowRxToCx(row, rx1);
+        int x2 = editorRowRxToCx(row, rx2);
+        if (rx1 == rx2)
+        {
+            if (c == BACKSPACE && x1 > 0)
+                x1--;
+            else if (c == DEL_KEY && x2 < row->size)
+                x2++;
+        }
+        if (x1 != x2 || insert)
+            editorRowReplace(row, x1, x2, &ch, insert);
+    }
+    editorBatchEnd();
+    editorBlockMoveTo(newrx);
+}
+
+/// @brief Copy the block to the clipboard, one line per row, and delete it too when cutting.
+void editorBlockCopy(int cut)
+{
+    int y1, y2, rx1, rx2;
+    if (!editorBlockBounds(&y1, &y2, &rx1, &rx2))
+        return;
+
+    editorClipboardClear();
+    zenClipboard.nlines = y2 - y1 + 1;
+    zenClipboard.lines = editorMalloc(MEM_CLIPBOARD, sizeof(struct clipLine) * zenClipboard.nlines);
+    zenClipboard.block = 1;
+    for (int y = y1; y <= y2; y++)
+    {
+        erow *row = &E->row[y];
+        int x1 = editorRowRxToCx(row, rx1);
+        int x2 = editorRowRxToCx(row, rx2);
+        struct clipLine *line = &zenClipboard.lines[y - y1];
+        line->len = x2 - x1;
+        line->s = editorMalloc(MEM_CLIPBOARD, line->len + 1);
+        memcpy(line->s, &row->chars[x1], line->len);
+        line->s[line->len] = '\0';
+    }
+
+    if (cut && rx1 != rx2)
+        editorBlockEdit(DEL_KEY);
+    E->sel_active = 0;
+    editorSetStatusMessage("%s a %dx%d block", cut ? "Cut" : "Copied", y2 - y1 + 1, rx2 - rx1);
+}
+
+/// @brief Paste a block: line i of the clipboard goes into row cy + i at the cursor's column, padding short rows with spaces.
+void editorBlockPaste()
+{
+    int rx = editorColumnAt(E->cy, E->cx);
+    char *pad = NULL;
+
+    editorBatchBegin();
+    for (int i = 0; i < zenClipboard.nlines; i++)
+    {
+        int y = E->cy + i;
+        if (y == E->numrows)
+            editorInsertRow(E->numrows, "", 0);
+
+        erow *row = &E->row[y];
+        if (row->rsize >= rx)
+        {
+            int x = editorRowRxToCx(row, rx);
+            editorRowReplace(row, x, x, zenClipboard.lines[i].s, zenClipboard.lines[i].len);
+            continue;
+        }
+
+        int npad = rx - row->rsize;
+        pad = realloc(pad, npad + zenClipboard.lines[i].len);
+        memset(pad, ' ', npad);
+        memcpy(&pad[npad], zenClipboard.lines[i].s, zenClipboard.lines[i].len);
+        editorRowReplace(row, row->size, row->size, pad, npad + zenClipboard.lines[i].len);
+    }
+    editorBatchEnd();
+    free(pad);
+}
+
+/// @brief Handle the keys that edit a block selection. Returns 0 for the other keys.
+int editorBlockKeypress(int c)
+{
+    if (c == BACKSPACE || c == CTRL_KEY('h'))
+        c = BACKSPACE;
+    else if (c != DEL_KEY && c != '\t' && (c < 32 || c >= 127))
+        return 0;
+    editorBlockEdit(c);
+    return 1;
+}
+
+/// @brief Get the selection in document order, clamped to the buffer. Returns 0 when nothing is selected.
+int editorSelectionBounds(int *y1, int *x1, int *y2, int *x2)
+{
+    if (!E->sel_active || E->sel_block)
+        return 0;
+
+    // Edits made since the anchor was set may have left it past the end of its row or of the buffer.
+    int ay = E->sel_cy < E->numrows ? E->sel_cy : E->numrows;
+    int ax = ay < E->numrows ? E->sel_cx : 0;
+    if (ay < E->numrows && ax > E->row[ay].size)
+        ax = E->row[ay].size;
+
+    if (ay < E->cy || (ay == E->cy && ax < E->cx))
+    {
+        *y1 = ay, *x1 = ax, *y2 = E->cy, *x2 = E->cx;
+    }
+    else
+    {
+        *y1 = E->cy, *x1 = E->cx, *y2 = ay, *x2 = ax;
+    }
+
+    // The position past the last row is the end of the last row.
+    if (*y2 == E->numrows && E->numrows > 0)
+    {
+        *y2 = E->numrows - 1;
+        *x2 = E->row[*y2].size;
+        if (*y1 == E->numrows)
+            *y1 = *y2, *x1 = *x2;
+    }
+    return *y1 < E->numrows;
+}
+
+/// @brief Render indexes [*rx1, *rx2) of row 'at' that are selected. Returns 0 if none of the row is.
+int editorSelectionRender(int at, int *rx1, int *rx2)
+{
+    if (E->sel_block)
+    {
+        int y1, y2;
+        if (!editorBlockBounds(&y1, &y2, rx1, rx2) || at < y1 || at > y2)
+            return 0;
+        // Show an empty block as a one column wide bar, so the column being edited is visible.
+        if (*rx1 == *rx2)
+            (*rx2)++;
+        return 1;
+    }
+
+    int y1, x1, y2, x2;
+    if (!editorSelectionBounds(&y1, &x1, &y2, &x2) || at < y1 || at > y2)
+        return 0;
+
+    erow *row = &E->row[at];
+    *rx1 = (at == y1) ? editorRowCxToRx(row, x1) : 0;
+    *rx2 = (at == y2) ? editorRowCxToRx(row, x2) : row->rsize;
+    return 1;
+}
+
+/// @brief Size of the selection in bytes, newlines included, or -1 when nothing is selected.
+long long editorSelectionSize()
+{
+    int y1, x1, y2, x2;
+    if (!editorSelectionBounds(&y1, &x1, &y2, &x2))
+        return -1;
+    return editorOffset(y2, x2) - editorOffset(y1, x1);
+}
+
+/// @brief Copy the selection to the clipboard. O(1): only the span is recorded, see struct editorClipboard.
+void editorCopy()
+{
+    if (E->sel_active && E->sel_block)
+    {
+        editorBlockCopy(0);
+        return;
+    }
+
+    int y1, x1, y2, x2;
+    if (!editorSelectionBounds(&y1, &x1, &y2, &x2))
+    {
+        editorSetStatusMessage("Nothing selected, set the mark with Ctrl-B");
+        return;
+    }
+
+    editorClipboardClear();
+    zenClipboard.live = 1;
+    zenClipboard.r1 = y1, zenClipboard.c1 = x1, zenClipboard.r2 = y2, zenClipboard.c2 = x2;
+    E->sel_active = 0;
+    editorSetStatusMessage("Copied %d lines", y2 - y1 + 1);
+}
+
+/// @brief Move the selection to the clipboard. The rows it covers entirely are handed over to the clipboard instead of copied.
+void editorCut()
+{
+    if (E->sel_active && E->sel_block)
+    {
+        editorBlockCopy(1);
+        return;
+    }
+
+    int y1, x1, y2, x2;
+    if (!editorSelectionBounds(&y1, &x1, &y2, &x2))
+    {
+        editorSetStatusMessage("Nothing selected, set the mark with Ctrl-B");
+        return;
+    }
+
+    editorClipboardClear();
+    int n = y2 - y1 + 1;
+    zenClipboard.lines = editorMalloc(MEM_CLIPBOARD, sizeof(struct clipLine) * n);
+    zenClipboard.nlines = n;
+    for (int j = y1; j <= y2; j++)
+    {
+        erow *row = &E->row[j];
+        struct clipLine *line = &zenClipboard.lines[j - y1];
+        if (j > y1 && j < y2)
+        {
+            // editorDeleteText() is about to free this row anyway: take its text instead.
+            line->s = row->chars;
+            line->len = row->size;
+            row->chars = NULL;
+            editorMemMove(MEM_CHARS, MEM_CLIPBOARD, line->s);
+            continue;
+        }
+        int from = (j == y1) ? x1 : 0;
+        int to = (j == y2) ? x2 : row->size;
+        line->len = to - from;
+        line->s = editorMalloc(MEM_CLIPBOARD, line->len + 1);
+        memcpy(line->s, &row->chars[from], line->len);
+        line->s[line->len] = '\0';
+    }
+
+    editorBatchBegin();
+    editorDeleteText(y1, x1, y2, x2);
+    editorBatchEnd();
+    E->cy = y1;
+    E->cx = x1;
+    E->sel_active = 0;
+    editorSetStatusMessage("Cut %d lines", n);
+}
+
+/// @brief Insert the clipboard at the cursor. Whole lines are spliced in with one editorInsertRows().
+void editorPaste()
+{
+    if (zenClipboard.block)
+    {
+        editorBlockPaste();
+        return;
+    }
+
+    // The cursor row changes first: if the clipboard refers to it, it must take its copy before the row is touched.
+    editorClipboardProtect(E->cy);
+
+    int n;
+    struct clipLine *lines = editorClipboardSpans(&n);
+    if (n == 0)
+    {
+        editorFree(MEM_CLIPBOARD, lines);
+        editorSetStatusMessage("The clipboard is empty");
+        return;
+    }
+
+    editorBatchBegin();
+    if (E->cy == E->numrows)
+        editorInsertRow(E->numrows, "", 0);
+
+    if (n == 1)
+    {
+        editorRowInsertString(&E->row[E->cy], E->cx, lines[0].s, lines[0].len);
+        E->cx += lines[0].len;
+    }
+    else
+    {
+        // The cursor row keeps what is left of the cursor plus the first line, the last line gets what was right of it.
+        erow *row = &E->row[E->cy];
+        int taillen = row->size - E->cx;
+        char *tail = malloc(taillen + 1);
+        memcpy(tail, &row->chars[E->cx], taillen);
+
+        editorRowDelString(row, E->cx, taillen);
+        editorRowAppendString(&E->row[E->cy], lines[0].s, lines[0].len);
+        editorInsertRows(E->cy + 1, &lines[1], n - 1);
+        E->cy += n - 1;
+        E->cx = lines[n - 1].len;
+        editorRowAppendString(&E->row[E->cy], tail, taillen);
+        free(tail);
+    }
+    editorBatchEnd();
+    editorFree(MEM_CLIPBOARD, lines);
+}
+
+/*** filter through command ***/
+
+/// @brief Give row 'at' the text 's' (taking ownership of it) with a single update of the row.
+void editorPipeSetRow(int at, char *s, int len)
+{
+    erow *row = &E->row[at];
+    editorStatsRemove(row);
+    editorRowResized(row, len - row->size);
+    editorFree(MEM_CHARS, row->chars);
+    row->chars = s;
+    row->size = len;
+    editorStatsAdd(row);
+    editorUpdateRow(row);
+}
+
+/// @brief Put a line of output in the next free slot, or queue it.
+void editorPipeEmit(const char *s, int len)
+{
+    char *line = editorMalloc(MEM_CHARS, len + 1);
+    memcpy(line, s, len);
+    line[len] = '\0';
+    E->pipe.bytesout += len + 1;
+
+    if (E->pipe.filled < E->pipe.sent && E->pipe.phead == E->pipe.npending)
+    {
+        editorPipeSetRow(E->pipe.y1 + E->pipe.filled++, line, len);
+        return;
+    }
+    if (E->pipe.npending == E->pipe.pcap)
+    {
+        E->pipe.pcap = E->pipe.pcap ? E->pipe.pcap * 2 : 256;
+        E->pipe.pending = editorRealloc(MEM_PIPE, E->pipe.pending, sizeof(struct clipLine) * E->pipe.pcap);
+    }
+    E->pipe.pending[E->pipe.npending].s = line;
+    E->pipe.pending[E->pipe.npending].len = len;
+    E->pipe.npending++;
+}
+
+/// @brief Row E->pipe.y1 + E->pipe.sent has been handed over: empty it, and fill it from the queue if output is waiting.
+void editorPipeRowSent()
+{
+    E->pipe.sent++;
+    if (E->pipe.phead < E->pipe.npending)
+    {
+        editorPipeSetRow(E->pipe.y1 + E->pipe.filled++, E->pipe.pending[E->pipe.phead].s, E->pipe.pending[E->pipe.phead].len);
+        E->pipe.phead++;
+        return;
+    }
+    char *empty = editorMalloc(MEM_CHARS, 1);
+    empty[0] = '\0';
+    editorPipeSetRow(E->pipe.y1 + E->pipe.sent - 1, empty, 0);
+}
+
+/// @brief Write as much input to the command as its pipe takes.
+void editorPipeWrite()
+{
+    while (E->pipe.infd != -1)
+    {
+        if (E->pipe.stagepos == E->pipe.stagelen)
+        {
+            // Refill the stage from the rows, emptying each row once all of it is copied.
+            E->pipe.stagepos = E->pipe.stagelen = 0;
+            while (E->pipe.stagelen < ZEN_PIPE_CHUNK && E->pipe.wrow < E->pipe.y1 + E->pipe.n)
+            {
+                erow *row = &E->row[E->pipe.wrow];
+                int take = row->size - E->pipe.woff;
+                if (take > ZEN_PIPE_CHUNK - E->pipe.stagelen)
+                    take = ZEN_PIPE_CHUNK - E->pipe.stagelen;
+                memcpy(&E->pipe.stage[E->pipe.stagelen], &row->chars[E->pipe.woff], take);
+                E->pipe.stagelen += take;
+                E->pipe.woff += take;
+                if (E->pipe.woff < row->size || E->pipe.stagelen == ZEN_PIPE_CHUNK)
+                    break;
+                E->pipe.stage[E->pipe.stagelen++] = '\n';
+                E->pipe.wrow++;
+                E->pipe.woff = 0;
+                editorPipeRowSent();
+            }
+            // Keep a copy of the input before it goes, the rows it came from are emptied. If the copy can't be written,
+            // no more input is sent, so no row is emptied that could not be put back.
+            if (E->pipe.stagelen && fwrite(E->pipe.stage, 1, E->pipe.stagelen, E->pipe.spill) != (size_t)E->pipe.stagelen)
+                E->pipe.stagelen = 0;
+            if (E->pipe.stagelen == 0)
+            {
+                close(E->pipe.infd);
+                E->pipe.infd = -1;
+                return;
+            }
+        }
+
+        ssize_t n = write(E->pipe.infd, &E->pipe.stage[E->pipe.stagepos], E->pipe.stagelen - E->pipe.stagepos);
+        if (n == -1)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return;
+            // The command stopped reading (EPIPE): the rest of the input is dropped along with the region.
+            close(E->pipe.infd);
+            E->pipe.infd = -1;
+            return;
+        }
+        E->pipe.stagepos += n;
+    }
+}
+
+/// @brief Take in the command's output, split into lines. Returns 1 once the command closed its stdout.
+int editorPipeRead()
+{
+    char chunk[ZEN_PIPE_CHUNK];
+    long budget = ZEN_PIPE_BUDGET;
+    while (budget > 0)
+    {
+        ssize_t n = read(E->pipe.outfd, chunk, sizeof(chunk));
+        if (n == -1)
+            return errno != EAGAIN && errno != EINTR;
+        if (n == 0)
+            return 1;
+        budget -= n;
+
+        int start = 0;
+        char *nl;
+        while ((nl = memchr(&chunk[start], '\n', n - start)) != NULL)
+        {
+            int len = nl - &chunk[start];
+            if (E->pipe.partlen)
+            {
+                E->pipe.partial = editorRealloc(MEM_PIPE, E->pipe.partial, E->pipe.partlen + len);
+                memcpy(&E->pipe.partial[E->pipe.partlen], &chunk[start], len);
+                editorPipeEmit(E->pipe.partial, E->pipe.partlen + len);
+                E->pipe.partlen = 0;
+            }
+            else
+                editorPipeEmit(&chunk[start], len);
+            start += len + 1;
+        }
+        if (start < n)
+        {
+            E->pipe.partial = editorRealloc(MEM_PIPE, E->pipe.partial, E->pipe.partlen + n - start);
+            memcpy(&E->pipe.partial[E->pipe.partlen], &chunk[start], n - start);
+            E->pipe.partlen += n - start;
+        }
+    }
+    return 0;
+}
+
+/// @brief Put the rows handed over to the command back as they were, from the spill file. Returns 0 if they all could be.
+int editorPipeRestore()
+{
+    if (fflush(E->pipe.spill) == EOF || fseek(E->pipe.spill, 0, SEEK_SET) == -1)
+        return -1;
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t len = 0;
+    int j;
+    for (j = 0; j < E->pipe.sent && (len = getline(&line, &linecap, E->pipe.spill)) > 0; j++)
+    {
+        char *chars = editorMalloc(MEM_CHARS, len);
+        memcpy(chars, line, len - 1);
+        chars[len - 1] = '\0';
+        editorPipeSetRow(E->pipe.y1 + j, chars, len - 1);
+    }
+    free(line);
+    for (int i = E->pipe.phead; i < E->pipe.npending; i++)
+        editorFree(MEM_CHARS, E->pipe.pending[i].s);
+    return j == E->pipe.sent ? 0 : -1;
+}
+
+/// @brief The command is done (or aborted). If it exited with status 0, its output replaces the rows: drop what is left
+/// of the input and put the queued output in. Otherwise the rows are put back as they were. Either way, reap it.
+void editorPipeFinish(int aborted)
+{
+    if (E->pipe.infd != -1)
+        close(E->pipe.infd);
+    close(E->pipe.outfd);
+    if (aborted)
+        kill(E->pipe.pid, SIGTERM);
+    int status = 0;
+    waitpid(E->pipe.pid, &status, 0);
+
+    editorBatchBegin();
+    if (aborted || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        int restored = editorPipeRestore();
+        editorBatchEnd();
+        fclose(E->pipe.spill);
+        editorFree(MEM_PIPE, E->pipe.pending);
+        editorFree(MEM_PIPE, E->pipe.partial);
+        int sent = E->pipe.sent;
+        memset(&E->pipe, 0, sizeof(E->pipe));
+        E->cx = 0;
+
+        const char *why = aborted ? "Filter aborted" : "Filter failed";
+        char reason[32] = "";
+        if (!aborted && WIFEXITED(status))
+            snprintf(reason, sizeof(reason), " with status %d", WEXITSTATUS(status));
+        if (restored == 0)
+            editorSetStatusMessage("%s%s, the lines were left as they were", why, reason);
+        else
+            editorSetStatusMessage("%s%s, and the temporary copy of the lines is unreadable: %d lines may be empty", why, reason, sent);
+        return;
+    }
+
+    if (E->pipe.partlen)
+        editorPipeEmit(E->pipe.partial, E->pipe.partlen);
+
+    // Rows after the last filled slot are either emptied input or input the command never read.
+    editorDelRows(E->pipe.y1 + E->pipe.filled, E->pipe.n - E->pipe.filled);
+    int queued = E->pipe.npending - E->pipe.phead;
+    if (queued > 0)
+    {
+        struct clipLine *empty = calloc(queued, sizeof(struct clipLine));
+        for (int i = 0; i < queued; i++)
+            empty[i].s = "";
+        editorInsertRows(E->pipe.y1 + E->pipe.filled, empty, queued);
+        free(empty);
+        for (int i = 0; i < queued; i++)
+            editorPipeSetRow(E->pipe.y1 + E->pipe.filled + i, E->pipe.pending[E->pipe.phead + i].s, E->pipe.pending[E->pipe.phead + i].len);
+    }
+    editorBatchEnd();
+
+    int lines = E->pipe.filled + queued;
+    fclose(E->pipe.spill);
+    editorFree(MEM_PIPE, E->pipe.pending);
+    editorFree(MEM_PIPE, E->pipe.partial);
+    memset(&E->pipe, 0, sizeof(E->pipe));
+
+    if (E->cy > E->numrows)
+        E->cy = E->numrows;
+    E->cx = 0;
+    editorSetStatusMessage("Filtered into %d lines", lines);
+}
+
+/// @brief Start filtering rows [y1, y2] through the shell command 'cmd'. The work is done from the event loop.
+void editorPipeStart(const char *cmd, int y1, int y2)
+{
+    // Without a place to keep the rows, a failing command would lose them.
+    FILE *spill = tmpfile();
+    if (spill == NULL)
+    {
+        editorSetStatusMessage("Can't filter, no temporary file: %s", strerror(errno));
+        return;
+    }
+    int in[2], out[2];
+    if (pipe(in) == -1)
+    {
+        fclose(spill);
+        return;
+    }
+    if (pipe(out) == -1)
+    {
+        close(in[0]);
+        close(in[1]);
+        fclose(spill);
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        editorSetStatusMessage("fork: %s", strerror(errno));
+        close(in[0]), close(in[1]), close(out[0]), close(out[1]);
+        fclose(spill);
+        return;
+    }
+    if (pid == 0)
+    {
+        // The command must not write over the screen, so its stderr goes nowhere.
+        int null = open("/dev/null", O_WRONLY);
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        close(in[0]), close(in[1]), close(out[0]), close(out[1]), close(null);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+    fcntl(in[1], F_SETFL, O_NONBLOCK);
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+
+    // The slots are found by row number, so the clipboard must not refer to rows at or below the region.
+    editorClipboardProtectRows(y1, E->numrows - 1);
+    memset(&E->pipe, 0, sizeof(E->pipe));
+    E->pipe.pid = pid;
+    E->pipe.infd = in[1];
+    E->pipe.outfd = out[0];
+    E->pipe.y1 = y1;
+    E->pipe.n = y2 - y1 + 1;
+    E->pipe.wrow = y1;
+    E->pipe.spill = spill;
+    E->cy = y1;
+    E->cx = 0;
+    editorSetStatusMessage("Filtering %d lines through '%s'... (Esc to abort)", E->pipe.n, cmd);
+}
+
+/// @brief Move data through the command's pipes after poll() reported them ready.
+void editorPipeService(short inready, short outready)
+{
+    editorBatchBegin();
+    if (E->pipe.infd != -1 && inready)
+        editorPipeWrite();
+    int done = outready && editorPipeRead();
+    editorBatchEnd();
+
+    if (done)
+        editorPipeFinish(0);
+    else
+        editorSetStatusMessage("Filtering: %d lines sent, %lld bytes back (Esc to abort)", E->pipe.sent, E->pipe.bytesout);
+}
+
+/*** line commands ***/
+
+/// @brief A row being sorted: a key that decides most comparisons, and the row itself for ties.
+struct sortItem
+{
+    uint64_t key;
+    erow *row;
+};
+
+/// @brief A part of the sort done by one thread.
+struct sortTask
+{
+    struct sortItem *items;
+    struct sortItem *tmp;
+    size_t n;
+    int depth; // The task splits in two threads 'depth' more times.
+};
+
+/// @brief A part of the rows of a uniq or filter command, decided on by one thread.
+struct keepTask
+{
+    erow *row;           // The rows of the buffer.
+    int y1, y2;          // Rows this task decides on.
+    int base;            // Row that keep[0] stands for.
+    char *keep;
+    const char *pattern; // Extended regular expression to match, NULL to drop repeated rows instead.
+    int invert;
+    int removed;
+    int error; // The pattern does not compile.
+};
+
+/// @brief The rows a line command works on: the rows of the selection if there is one, else the whole buffer.
+int editorCommandRange(int *y1, int *y2)
+{
+    int x1, x2, rx1, rx2;
+    if (!editorSelectionBounds(y1, &x1, y2, &x2) && !editorBlockBounds(y1, y2, &rx1, &rx2))
+    {
+        *y1 = 0;
+        *y2 = E->numrows - 1;
+    }
+    return *y2 >= *y1;
+}
+
+/// @brief Sort key of a row: its first 8 bytes, big-endian, so that comparing keys compares the bytes.
+uint64_t editorSortKeyText(erow *row)
+{
+    uint64_t key = 0;
+    for (int j = 0; j < 8; j++)
+        key = (key << 8) | (j < row->size ? (unsigned char)row->chars[j] : 0);
+    return key;
+}
+
+/// @brief Sort key of a row for numeric sorting: the number the row starts with (0 if none), as bits that order like the number.
+uint64_t editorSortKeyNumber(erow *row)
+{
+    double d = strtod(row->chars, NULL);
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    // Flip negative numbers entirely and set the sign bit of positive ones: unsigned comparison then orders like the doubles.
+    return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+}
+
+int editorSortCompare(const struct sortItem *a, const struct sortItem *b)
+{
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    int n = a->row->size < b->row->size ? a->row->size : b->row->size;
+    int c = memcmp(a->row->chars, b->row->chars, n);
+    if (c)
+        return c;
+    return (a->row->size > b->row->size) - (a->row->size < b->row->size);
+}
+
+/// @brief Merge the sorted halves [0, h) and [h, n) of 'items', through 'tmp'.
+void editorSortMerge(struct sortItem *items, struct sortItem *tmp, size_t h, size_t n)
+{
+    if (editorSortCompare(&items[h - 1], &items[h]) <= 0)
+        return; // Already in order, common for partly sorted input.
+
+    size_t i = 0, j = h, k = 0;
+    while (i < h && j < n)
+        tmp[k++] = (editorSortCompare(&items[j], &items[i]) < 0) ? items[j++] : items[i++];
+    while (i < h)
+        tmp[k++] = items[i++];
+    // What is left of the right half is already in place.
+    memcpy(items, tmp, sizeof(struct sortItem) * k);
+}
+
+/// @brief Stable merge sort of 'n' items, using 'tmp' as scratch space.
+void editorSortSerial(struct sortItem *items, struct sortItem *tmp, size_t n)
+{
+    if (n < 16)
+    {
+        for (size_t i = 1; i < n; i++)
+        {
+            struct sortItem it = items[i];
+            size_t j = i;
+            for (; j > 0 && editorSortCompare(&it, &items[j - 1]) < 0; j--)
+                items[j] = items[j - 1];
+            items[j] = it;
+        }
+        return;
+    }
+
+    size_t h = n / 2;
+    editorSortSerial(items, tmp, h);
+    editorSortSerial(&items[h], &tmp[h], n - h);
+    editorSortMerge(items, tmp, h, n);
+}
+
+/// @brief Thread body of the parallel merge sort: sort the left half in a new thread and the right half in this one, then merge.
+void *editorSortThread(void *arg)
+{
+    struct sortTask *t = arg;
+    uint64_t start = editorPerfNow();
+    if (t->depth == 0 || t->n < ZEN_SORT_SERIAL)
+    {
+        editorSortSerial(t->items, t->tmp, t->n);
+        editorTraceSpan("sort_serial", start, editorPerfNow());
+        return NULL;
+    }
+
+    size_t h = t->n / 2;
+    struct sortTask left = {t->items, t->tmp, h, t->depth - 1};
+    struct sortTask right = {&t->items[h], &t->tmp[h], t->n - h, t->depth - 1};
+    pthread_t thread;
+    int spawned = (pthread_create(&thread, NULL, editorSortThread, &left) == 0);
+    if (!spawned)
+        editorSortThread(&left);
+    editorSortThread(&right);
+    if (spawned)
+        pthread_join(thread, NULL);
+
+    start = editorPerfNow();
+    editorSortMerge(t->items, t->tmp, h, t->n);
+    editorTraceSpan("sort_merge", start, editorPerfNow());
+    return NULL;
+}
+
+/// @brief Sort rows [y1, y2] by moving the erow structs, never the text. Returns -1, with a status message, when there
+/// is not enough memory for the sort.
+int editorSortRows(int y1, int y2, int numeric, int reverse)
+{
+    size_t n = y2 - y1 + 1;
+    struct sortItem *items = malloc(sizeof(struct sortItem) * n);
+    struct sortItem *tmp = malloc(sizeof(struct sortItem) * n);
+    erow *sorted = malloc(sizeof(erow) * n);
+    if (items == NULL || tmp == NULL || sorted == NULL)
+    {
+        free(items);
+        free(tmp);
+        free(sorted);
+        editorSetStatusMessage("Not enough memory to sort %zu lines", n);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        erow *row = &E->row[y1 + i];
+        items[i].key = numeric ? editorSortKeyNumber(row) : editorSortKeyText(row);
+        items[i].row = row;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int depth = 0;
+    while (depth < 30 && (1L << (depth + 1)) <= cpus && (1 << (depth + 1)) <= ZEN_SORT_THREADS)
+        depth++;
+    struct sortTask task = {items, tmp, n, depth};
+    editorSortThread(&task);
+
+    // Lay the erow structs out in their new order, then put them back in place.
+    editorClipboardProtectRows(y1, y2);
+    for (size_t i = 0; i < n; i++)
+        sorted[i] = *items[reverse ? n - 1 - i : i].row;
+    memcpy(&E->row[y1], sorted, sizeof(erow) * n);
+    free(sorted);
+    free(tmp);
+    free(items);
+
+    editorBatchBegin();
+    for (int j = y1; j <= y2; j++)
+    {
+        E->row[j].idx = j;
+        editorBatchTouch(j);
+    }
+    // Only the order changed: the statistics stand, the weights of the row indexes just moved around.
+    E->wrapidx.stale = 1;
+    E->byteidx.stale = 1;
+    E->dirty++;
+    editorBatchEnd();
+    return 0;
+}
+
+/// @brief Thread body of uniq and filter: decide which rows of the task's part to keep.
+void *editorKeepThread(void *arg)
+{
+    struct keepTask *t = arg;
+    uint64_t start = editorPerfNow();
+    // Every thread compiles its own copy: regexec() on a shared one would have them take turns on its lock.
+    regex_t re;
+    if (t->pattern && regcomp(&re, t->pattern, REG_EXTENDED | REG_NOSUB) != 0)
+    {
+        t->error = 1;
+        return NULL;
+    }
+    for (int j = t->y1; j <= t->y2; j++)
+    {
+        int keep;
+        if (t->pattern)
+            keep = (regexec(&re, t->row[j].chars, 0, NULL, 0) == 0) != t->invert;
+        else
+        {
+            erow *a = &t->row[j - 1], *b = &t->row[j];
+            keep = j == t->base || a->size != b->size || memcmp(a->chars, b->chars, a->size);
+        }
+        t->keep[j - t->base] = keep;
+        t->removed += !keep;
+    }
+    if (t->pattern)
+        regfree(&re);
+    editorTraceSpan(t->pattern ? "filter_part" : "uniq_part", start, editorPerfNow());
+    return NULL;
+}
+
+/// @brief Decide which rows of [y1, y2] to keep into 'keep', splitting large ranges across threads. Returns the number
+/// of rows to remove, or -1 if 'pattern' does not compile.
+int editorKeepDecide(int y1, int y2, char *keep, const char *pattern, int invert)
+{
+    long long n = y2 - y1 + 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int nt = 1;
+    while (nt * 2 <= cpus && nt * 2 <= ZEN_SORT_THREADS && n / (nt * 2) >= ZEN_SORT_SERIAL)
+        nt *= 2;
+
+    struct keepTask tasks[ZEN_SORT_THREADS];
+    pthread_t threads[ZEN_SORT_THREADS];
+    int spawned[ZEN_SORT_THREADS];
+    for (int i = 0; i < nt; i++)
+        tasks[i] = (struct keepTask){E->row, y1 + n * i / nt, y1 + n * (i + 1) / nt - 1, y1, keep, pattern, invert, 0, 0};
+    for (int i = 1; i < nt; i++)
+    {
+        spawned[i] = (pthread_create(&threads[i], NULL, editorKeepThread, &tasks[i]) == 0);
+        if (!spawned[i])
+            editorKeepThread(&tasks[i]);
+    }
+    editorKeepThread(&tasks[0]);
+
+    int removed = 0, error = 0;
+    for (int i = 0; i < nt; i++)
+    {
+        if (i > 0 && spawned[i])
+            pthread_join(threads[i], NULL);
+        removed += tasks[i].removed;
+        error |= tasks[i].error;
+    }
+    return error ? -1 : removed;
+}
+
+/// @brief Keep the rows of [y1, y2] for which keep[j - y1] is set and delete the others, in one pass over the rows.
+void editorKeepRows(int y1, int y2, const char *keep)
+{
+    editorClipboardProtectRows(y1, E->numrows - 1);
+
+    int dst = y1;
+    for (int j = y1; j <= y2; j++)
+    {
+        if (keep[j - y1])
+        {
+            E->row[dst] = E->row[j];
+            E->row[dst].idx = dst;
+            dst++;
+            continue;
+        }
+        E->totalbytes -= editorRowBytes(&E->row[j]);
+        editorStatsRemove(&E->row[j]);
+        editorFreeRow(&E->row[j]);
+    }
+
+    int removed = y2 + 1 - dst;
+    if (removed == 0)
+        return;
+    memmove(&E->row[dst], &E->row[y2 + 1], sizeof(erow) * (E->numrows - y2 - 1));
+    E->numrows -= removed;
+    for (int j = dst; j < E->numrows; j++)
+        E->row[j].idx = j;
+
+    E->wrapidx.stale = 1;
+    E->byteidx.stale = 1;
+    E->dirty++;
+    editorUpdateGutter();
+
+    // Rows that lost the row above them may start in a different comment state.
+    editorBatchBegin();
+    for (int j = y1; j <= dst && j < E->numrows; j++)
+        editorBatchTouch(j);
+    editorBatchEnd();
+}
+
+/// @brief Delete the rows of [y1, y2] that repeat the row just above them, like uniq(1). Returns how many were
+/// deleted, or -1, with a status message, when there is not enough memory.
+int editorUniqRows(int y1, int y2)
+{
+    char *keep = malloc(y2 - y1 + 1);
+    if (keep == NULL)
+    {
+        editorSetStatusMessage("Not enough memory for %d lines", y2 - y1 + 1);
+        return -1;
+    }
+    int removed = editorKeepDecide(y1, y2, keep, NULL, 0);
+    editorKeepRows(y1, y2, keep);
+    free(keep);
+    return removed;
+}
+
+/// @brief Keep only the rows of [y1, y2] matching the extended regular expression 'pattern', or only those not matching
+/// it. Returns how many rows were deleted, or -1, with a status message, if the pattern is bad or memory short.
+int editorFilterRows(int y1, int y2, const char *pattern, int invert)
+{
+    char *keep = malloc(y2 - y1 + 1);
+    if (keep == NULL)
+    {
+        editorSetStatusMessage("Not enough memory for %d lines", y2 - y1 + 1);
+        return -1;
+    }
+    int removed = editorKeepDecide(y1, y2, keep, pattern, invert);
+    if (removed < 0)
+        editorSetStatusMessage("Bad pattern: %s", pattern);
+    else
+        editorKeepRows(y1, y2, keep);
+    free(keep);
+    return removed;
+}
+
+/// @brief Run a command typed at the Ctrl-P prompt.
+void editorCommand(char *line)
+{
+    char *arg = line;
+    int y1, y2;
+    if (!strcmp(line, "hex"))
+    {
+        editorHexToggle();
+        return;
+    }
+    if (!strcmp(line, "perf") || !strncmp(line, "perf ", 5))
+    {
+        editorPerfCommand(line[4] ? line + 5 : NULL);
+        return;
+    }
+    if (!strcmp(line, "mem") || !strncmp(line, "mem ", 4))
+    {
+        editorMemCommand(line[3] ? line + 4 : NULL);
+        return;
+    }
+    if (!strcmp(line, "gzip"))
+    {
+        E->compressed = !E->compressed;
+        editorSetStatusMessage(E->compressed ? "The file will be saved gzip-compressed" : "The file will be saved uncompressed");
+        return;
+    }
+    if (E->hex)
+    {
+        editorSetStatusMessage("Only 'hex' works in the hex view");
+        return;
+    }
+    if (!editorCommandRange(&y1, &y2))
+        return;
+
+    if (line[0] == '!')
+    {
+        E->sel_active = 0;
+        editorPipeStart(line + 1, y1, y2);
+        return;
+    }
+
+    char *cmd = strsep(&arg, " ");
+
+    if (!strcmp(cmd, "sort"))
+    {
+        int numeric = 0, reverse = 0;
+        char *opt;
+        while (arg && (opt = strsep(&arg, " ")) != NULL)
+        {
+            numeric |= !strcmp(opt, "-n");
+            reverse |= !strcmp(opt, "-r");
+        }
+        if (editorSortRows(y1, y2, numeric, reverse) == 0)
+            editorSetStatusMessage("Sorted %d lines", y2 - y1 + 1);
+    }
+    else if (!strcmp(cmd, "uniq"))
+    {
+        int removed = editorUniqRows(y1, y2);
+        if (removed >= 0)
+            editorSetStatusMessage("Removed %d duplicate lines", removed);
+    }
+    else if (!strcmp(cmd, "filter") && arg)
+    {
+        int invert = !strncmp(arg, "-v ", 3);
+        int removed = editorFilterRows(y1, y2, invert ? arg + 3 : arg, invert);
+        if (removed >= 0)
+            editorSetStatusMessage("Removed %d lines", removed);
+    }
+    else
+    {
+        editorSetStatusMessage("Unknown command: %s", cmd);
+        return;
+    }
+
+    E->sel_active = 0;
+    if (E->cy > E->numrows)
+        E->cy = E->numrows;
+    if (E->cx > (E->cy < E->numrows ? E->row[E->cy].size : 0))
+        E->cx = E->cy < E->numrows ? E->row[E->cy].size : 0;
+}
+
+/*** file i/o ***/
+
+/// @brief Converts our array of erow structs into a single string that is ready to be written out to a file.
+char *editorRowsToString(int *buflen)
+{
+    // Add up the lengths of each row of text, with the line ending ("\n" or "\r\n") that will be added to the end of each line.
+    // The byte order mark and a missing final newline are put back as they were in the file.
+    int totlen = E->bom ? 3 : 0;
+    int j;
+    for (j = 0; j < E->numrows; j++)
+    {
+        totlen += editorRowBytes(&E->row[j]);
+    }
+    if (E->noeol && E->numrows)
+        totlen -= 1 + E->row[E->numrows - 1].crlf;
+    *buflen = totlen;
+
+    // Create and copy the contents to the buffer.
+    char *buf = malloc(totlen);
+    char *p = buf; // p pointer for adding the newline character.
+    if (E->bom)
+    {
+        memcpy(p, "\xef\xbb\xbf", 3);
+        p += 3;
+    }
+    for (j = 0; j < E->numrows; j++)
+    {
+        memcpy(p, E->row[j].chars, E->row[j].size);
+        p += E->row[j].size;
+        if (E->noeol && j == E->numrows - 1)
+            break;
+        if (E->row[j].crlf)
+            *p++ = '\r';
+        *p = '\n';
+        p++;
+    }
+    return buf;
+}
+
+/// @brief Write the rows to 'fd' the way editorRowsToString() lays them out, through a small buffer instead of one copy of the whole text.
+int editorWriteRows(int fd)
+{
+    char buf[ZEN_PIPE_CHUNK];
+    int len = 0;
+    if (E->bom)
+    {
+        memcpy(buf, "\xef\xbb\xbf", 3);
+        len = 3;
+    }
+    for (int j = 0; j < E->numrows; j++)
+    {
+        erow *row = &E->row[j];
+        int eol = (E->noeol && j == E->numrows - 1) ? 0 : 1 + row->crlf;
+        if (len + row->size + eol > (int)sizeof(buf))
+        {
+            if (write(fd, buf, len) != len)
+                return -1;
+            len = 0;
+            // A row longer than the buffer goes out on its own.
+            if (row->size + eol > (int)sizeof(buf))
+            {
+                if (write(fd, row->chars, row->size) != row->size)
+                    return -1;
+                if (eol && write(fd, "\r\n" + 2 - eol, eol) != eol)
+                    return -1;
+                continue;
+            }
+        }
+        memcpy(&buf[len], row->chars, row->size);
+        len += row->size;
+        if (row->crlf && eol)
+            buf[len++] = '\r';
+        if (eol)
+            buf[len++] = '\n';
+    }
+    return write(fd, buf, len) == len ? 0 : -1;
+}
+
+/// @brief 64-bit FNV-1a hash, continuing from 'h'.
+uint64_t editorHash(uint64_t h, const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+#define ZEN_HASH_INIT 0xcbf29ce484222325ULL
+
+/// @brief Fingerprint of a file's content. Only the ends are hashed, size and mtime catch the rest.
+uint64_t editorCacheContentHash(const char *data, size_t size)
+{
+    uint64_t h = ZEN_HASH_INIT;
+    if (size <= 2 * ZEN_CACHE_HASH_SPAN)
+        return editorHash(h, data, size);
+    h = editorHash(h, data, ZEN_CACHE_HASH_SPAN);
+    return editorHash(h, data + size - ZEN_CACHE_HASH_SPAN, ZEN_CACHE_HASH_SPAN);
+}
+
+/// @brief Path of the sidecar cache for 'filename', under $XDG_CACHE_HOME/zen or ~/.cache/zen. Creates the directory if 'create' is set.
+char *editorCachePath(const char *filename, const char *ext, int create)
+{
+    char *real = realpath(filename, NULL);
+    if (real == NULL)
+        return NULL;
+    uint64_t key = editorHash(ZEN_HASH_INIT, real, strlen(real));
+    free(real);
+
+    char dir[4096];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg)
+        snprintf(dir, sizeof(dir), "%s", xdg);
+    else if (home && *home)
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    else
+        return NULL;
+
+    if (create)
+        mkdir(dir, 0700);
+    size_t len = strlen(dir);
+    snprintf(dir + len, sizeof(dir) - len, "/zen");
+    if (create)
+        mkdir(dir, 0700);
+
+    size_t size = strlen(dir) + strlen(ext) + 18;
+    char *path = malloc(size);
+    if (path == NULL)
+        return NULL;
+    snprintf(path, size, "%s/%016llx%s", dir, (unsigned long long)key, ext);
+    return path;
+}
+
+/// @brief Fill in the cache header describing the file as it is on disk right now.
+void editorCacheFillHeader(struct editorCacheHeader *h, struct stat *st, const char *data)
+{
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, ZEN_CACHE_MAGIC, sizeof(ZEN_CACHE_MAGIC));
+    h->size = st->st_size;
+    h->mtime_sec = st->st_mtim.tv_sec;
+    h->mtime_nsec = st->st_mtim.tv_nsec;
+    h->hash = editorCacheContentHash(data, st->st_size);
+    h->syntax = E->syntax ? editorHash(ZEN_HASH_INIT, E->syntax->filetype, strlen(E->syntax->filetype)) : 0;
+}
+
+/// @brief A sidecar cache file, as seen by editorCacheTrim().
+struct cacheEntry
+{
+    char *name;
+    off_t size;
+    time_t mtime;
+};
+
+/// @brief qsort() comparator ordering cache files from the least recently used.
+int editorCacheEntryCompare(const void *a, const void *b)
+{
+    time_t ta = ((const struct cacheEntry *)a)->mtime, tb = ((const struct cacheEntry *)b)->mtime;
+    return (ta > tb) - (ta < tb);
+}
+
+/// @brief Remove the least recently used sidecar caches from the directory of 'keep' while they take more than ZEN_CACHE_MAX_SIZE.
+/// A cache is used when it is written or loaded, and 'keep' itself is never removed. Auto-save backups are left alone.
+void editorCacheTrim(const char *keep)
+{
+    char *dir = strdup(keep);
+    char *slash = dir ? strrchr(dir, '/') : NULL;
+    if (slash == NULL)
+    {
+        free(dir);
+        return;
+    }
+    *slash = '\0';
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        free(dir);
+        return;
+    }
+
+    struct cacheEntry *entries = NULL;
+    int n = 0, cap = 0;
+    long long total = 0;
+    struct dirent *de;
+    while ((de = readdir(d)))
+    {
+        size_t len = strlen(de->d_name);
+        if (len < 4 || strcmp(de->d_name + len - 4, ".idx"))
+            continue;
+        size_t size = strlen(dir) + len + 2;
+        char *path = malloc(size);
+        if (path == NULL)
+            break;
+        snprintf(path, size, "%s/%s", dir, de->d_name);
+        struct stat st;
+        if (stat(path, &st) == -1 || !S_ISREG(st.st_mode))
+        {
+            free(path);
+            continue;
+        }
+        if (n == cap)
+        {
+            struct cacheEntry *more = realloc(entries, sizeof(*entries) * (cap ? cap * 2 : 64));
+            if (more == NULL)
+            {
+                free(path);
+                break;
+            }
+            entries = more;
+            cap = cap ? cap * 2 : 64;
+        }
+        entries[n++] = (struct cacheEntry){path, st.st_size, st.st_mtime};
+        total += st.st_size;
+    }
+    closedir(d);
+
+    if (total > ZEN_CACHE_MAX_SIZE)
+        qsort(entries, n, sizeof(*entries), editorCacheEntryCompare);
+    for (int j = 0; j < n; j++)
+    {
+        if (total > ZEN_CACHE_MAX_SIZE && strcmp(entries[j].name, keep) && unlink(entries[j].name) == 0)
+            total -= entries[j].size;
+        free(entries[j].name);
+    }
+    free(entries);
+    free(dir);
+}
+
+/// @brief Write the line offsets and the comment state of every row to the sidecar cache. Failures are silently ignored, the cache is only an accelerator.
+void editorCacheStore(const char *filename, struct stat *st, const char *data, uint64_t *offsets)
+{
+    char *path = editorCachePath(filename, ".idx", 1);
+    if (path == NULL)
+        return;
+
+    struct editorCacheHeader h;
+    editorCacheFillHeader(&h, st, data);
+    h.numrows = E->numrows;
+
+    size_t nbits = (E->numrows + 7) / 8;
+    unsigned char *bits = calloc(nbits ? nbits : 1, 1);
+    size_t size = strlen(path) + 5;
+    char *tmp = malloc(size);
+    if (bits == NULL || tmp == NULL)
+    {
+        free(bits);
+        free(tmp);
+        free(path);
+        return;
+    }
+    for (int j = 0; j < E->numrows; j++)
+    {
+        if (E->row[j].hl_open_comment)
+            bits[j / 8] |= 1 << (j % 8);
+    }
+
+    // Write to a temporary file and rename it over the old cache, so a reader never sees a half written one.
+    snprintf(tmp, size, "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd != -1)
+    {
+        size_t olen = sizeof(uint64_t) * E->numrows;
+        int ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+                 write(fd, offsets, olen) == (ssize_t)olen &&
+                 write(fd, bits, nbits) == (ssize_t)nbits;
+        close(fd);
+        if (!ok || rename(tmp, path) == -1)
+            unlink(tmp);
+        else
+            editorCacheTrim(path);
+    }
+    free(bits);
+    free(tmp);
+    free(path);
+}
+
+/// @brief Check that the offsets of the cache 'h' (whose header matched) can be used to cut the file into rows: the first
+/// row starts at the top of the file or past its byte order mark, and every other row starts after the one before it, inside the file.
+int editorCacheOffsetsValid(struct editorCacheHeader *h, const char *data)
+{
+    uint64_t *offsets = (uint64_t *)(h + 1);
+    uint64_t first = (h->size >= 3 && !memcmp(data, "\xef\xbb\xbf", 3)) ? 3 : 0;
+    if (h->numrows == 0 || offsets[0] != first)
+        return 0;
+    for (uint64_t j = 1; j < h->numrows; j++)
+    {
+        if (offsets[j] <= offsets[j - 1])
+            return 0;
+    }
+    return offsets[h->numrows - 1] < h->size;
+}
+
+/// @brief Map the sidecar cache for a file if it is still valid for its current content. Returns the mapping (to munmap) or NULL,
+/// in which case the file is split the slow way.
+struct editorCacheHeader *editorCacheLoad(const char *filename, struct stat *st, const char *data, size_t *maplen)
+{
+    char *path = editorCachePath(filename, ".idx", 0);
+    if (path == NULL)
+        return NULL;
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1)
+        return NULL;
+
+    struct stat cst;
+    struct editorCacheHeader *h = NULL;
+    if (fstat(fd, &cst) == 0 && cst.st_size >= (off_t)sizeof(*h))
+    {
+        h = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (h == MAP_FAILED)
+            h = NULL;
+    }
+    if (h == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // Key on size, mtime and a content fingerprint, and make sure the file really holds as many offsets and bits as it claims.
+    // A row takes at least one byte, so numrows is bounded by the file size before it goes into the arithmetic.
+    struct editorCacheHeader want;
+    editorCacheFillHeader(&want, st, data);
+    if (memcmp(h->magic, want.magic, sizeof(want.magic)) || h->size != want.size || h->mtime_sec != want.mtime_sec ||
+        h->mtime_nsec != want.mtime_nsec || h->hash != want.hash || h->syntax != want.syntax || h->numrows > h->size ||
+        (uint64_t)cst.st_size != sizeof(*h) + h->numrows * sizeof(uint64_t) + (h->numrows + 7) / 8 ||
+        !editorCacheOffsetsValid(h, data))
+    {
+        close(fd);
+        munmap(h, cst.st_size);
+        return NULL;
+    }
+
+    // Mark the cache as recently used, for editorCacheTrim().
+    futimens(fd, NULL);
+    close(fd);
+    *maplen = cst.st_size;
+    return h;
+}
+
+/// @brief Strip the line ending from the line data[start, end) and append it as a row, remembering which ending it was.
+void editorOpenLine(const char *data, size_t start, size_t end)
+{
+    int eol = (end > start && data[end - 1] == '\n');
+    end -= eol;
+    int crlf = (eol && end > start && data[end - 1] == '\r');
+    end -= crlf;
+    editorInsertRow(E->numrows, (char *)&data[start], end - start);
+    editorRowSetEnding(&E->row[E->numrows - 1], crlf);
+    if (!eol)
+        E->noeol = 1;
+}
+
+/// @brief Opening and Reading a file from disk
+/*
+    Regular files are mapped into memory and split with memchr(). Large files get a sidecar cache holding the offset of every
+    line and the multi-line comment state at the end of every row. When the cache is still valid for the file, the rows are
+    cut straight at the stored offsets and highlighting is deferred until each row is first drawn, so the first screen comes
+    up without scanning or highlighting the whole file. Without a valid cache, a large file is loaded in the background
+    after its first screen, see editorLoadMapStart().
+
+    Returns -1, with errno set, if the file can't be read. The buffer is left as it was when it can't be opened at all.
+*/
+int editorOpenAs(char *filename, int hex)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    free(E->filename);
+    E->filename = strdup(filename);
+
+    editorSelectSyntaxHighlight();
+    E->crlf = E->bom = E->noeol = 0;
+    E->partial = 0;
+
+    struct stat st;
+    char *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // gzip files are inflated by a thread while the rows come in, see editorGunzipStart().
+    unsigned char *magic = (unsigned char *)data;
+    if (data != MAP_FAILED && hex != 1 && st.st_size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+        munmap(data, st.st_size);
+        return editorGunzipStart(fd);
+    }
+    if (data != MAP_FAILED && st.st_size >= 4 && !memcmp(magic, "\x28\xb5\x2f\xfd", 4))
+    {
+        editorSetStatusMessage("zstd compression is not supported, showing the raw bytes");
+        hex = 1;
+    }
+
+    // Binary files go to the hex view, which works straight from the mapping.
+    if (data != MAP_FAILED && (hex == 1 || (hex == -1 && memchr(data, '\0', st.st_size < ZEN_BINARY_PROBE ? st.st_size : ZEN_BINARY_PROBE))))
+    {
+        close(fd);
+        editorHexOpen((unsigned char *)data, st.st_size);
+        E->dirty = 0;
+        return 0;
+    }
+
+    if (data == MAP_FAILED)
+    {
+        // Not a regular file (or empty): read it line by line.
+        FILE *fp = fdopen(fd, "r");
+        if (!fp)
+        {
+            close(fd);
+            return -1;
+        }
+
+        char *line = NULL;
+        size_t linecap = 0;
+        ssize_t linelen;
+
+        /*
+            getline() is useful for reading lines from a file when we don’t know how much memory to allocate for each line.
+            It takes care of memory management for you. First, we pass it a null line pointer and a linecap (line capacity) of 0.
+            That makes it allocate new memory for the next line it reads, and set line to point to the memory, and set linecap to let you know how much memory it allocated.
+            Its return value is the length of the line it read, or -1 if it’s at the end of the file and there are no more lines to read.
+        */
+        while ((linelen = getline(&line, &linecap, fp)) != -1)
+        {
+            size_t start = 0;
+            if (E->numrows == 0 && linelen >= 3 && !memcmp(line, "\xef\xbb\xbf", 3))
+            {
+                E->bom = 1;
+                start = 3;
+            }
+            editorOpenLine(line, start, linelen);
+        }
+        free(line);
+        fclose(fp);
+
+        E->dirty = 0;
+        return 0;
+    }
+    close(fd);
+
+    // Line endings are told apart while splitting the lines (see editorOpenLine()), only a byte order mark is looked for here.
+    size_t size = st.st_size;
+    E->bom = (size >= 3 && !memcmp(data, "\xef\xbb\xbf", 3));
+    size_t maplen;
+    struct editorCacheHeader *cache = NULL;
+    if (size >= ZEN_CACHE_MIN_SIZE)
+        cache = editorCacheLoad(filename, &st, data, &maplen);
+
+    if (cache)
+    {
+        // Warm open: rows are cut at the cached offsets and their comment state is restored, highlighting is left for later.
+        // This is deliberately not an editorBatchBegin()/End() pair, the comment states are already right and nothing needs highlighting now.
+        // As for a cold open, a large file only gets its first screen here, and the loader brings in the rest.
+        uint64_t *offsets = (uint64_t *)(cache + 1);
+        unsigned char *bits = (unsigned char *)(offsets + cache->numrows);
+        int async = (size >= ZEN_LOAD_ASYNC_SIZE);
+        E->defer_syntax++;
+        for (uint64_t j = 0; j < cache->numrows; j++)
+        {
+            if (async && (int)j >= E->screenrows)
+            {
+                if (editorLoadCacheStart(data, &st, cache, maplen, j) == 0)
+                {
+                    E->defer_syntax--;
+                    E->dirty = 0;
+                    return 0;
+                }
+                async = 0;
+            }
+            editorOpenLine(data, offsets[j], j + 1 < cache->numrows ? offsets[j + 1] : size);
+            E->row[j].hl_open_comment = (bits[j / 8] >> (j % 8)) & 1;
+        }
+        E->defer_syntax--;
+        munmap(cache, maplen);
+    }
+    else
+    {
+        // Cold open: find the line breaks with memchr(), remembering where each line starts for the cache.
+        // A large file only gets its first screen here, the loader thread brings in the rest while the user can look at it.
+        // If the thread can't be started, the rest is split here after all.
+        size_t cap = 1024, n = 0;
+        uint64_t *offsets = malloc(sizeof(uint64_t) * cap);
+        size_t start = E->bom ? 3 : 0;
+        int async = (size >= ZEN_LOAD_ASYNC_SIZE);
+        while (start < size)
+        {
+            if (async && (int)n >= E->screenrows)
+            {
+                if (editorLoadMapStart(data, &st, start, offsets, n, cap) == 0)
+                {
+                    E->dirty = 0;
+                    return 0;
+                }
+                async = 0;
+            }
+
+            char *nl = memchr(data + start, '\n', size - start);
+            size_t end = nl ? (size_t)(nl - data) + 1 : size;
+
+            if (n == cap)
+            {
+                cap *= 2;
+                offsets = realloc(offsets, sizeof(uint64_t) * cap);
+            }
+            offsets[n++] = start;
+
+            editorOpenLine(data, start, end);
+            start = end;
+        }
+        if (size >= ZEN_CACHE_MIN_SIZE)
+            editorCacheStore(filename, &st, data, offsets);
+        free(offsets);
+    }
+    munmap(data, size);
+
+    E->dirty = 0;
+    return 0;
+}
+
+/// @brief Open a file, as text or, if it looks binary, in the hex view. A file that does not exist yet gives an empty
+/// buffer, the first save creates it. Returns -1, with errno set, if it exists but can't be read.
+int editorOpen(char *filename)
+{
+    if (editorOpenAs(filename, -1) == -1)
+    {
+        if (errno != ENOENT)
+            return -1;
+        free(E->filename);
+        E->filename = strdup(filename);
+        editorSelectSyntaxHighlight();
+    }
+    editorDiskStamp();
+    return 0;
+}
+
+/// @brief Remember the modification time and size the file has now, see editorDiskChanged().
+void editorDiskStamp()
+{
+    struct stat st;
+    if (E->filename && stat(E->filename, &st) == 0)
+    {
+        E->disk_mtime = st.st_mtim;
+        E->disk_size = st.st_size;
+    }
+    else
+    {
+        E->disk_mtime = (struct timespec){0, 0};
+        E->disk_size = -1; // Not there: it has changed if it appears.
+    }
+}
+
+/// @brief Whether the file was changed (or created, or removed) by someone else since it was last opened or saved.
+int editorDiskChanged()
+{
+    struct stat st;
+    if (E->filename == NULL)
+        return 0;
+    if (stat(E->filename, &st) == -1)
+        return E->disk_size != -1;
+    return st.st_size != E->disk_size || st.st_mtim.tv_sec != E->disk_mtime.tv_sec || st.st_mtim.tv_nsec != E->disk_mtime.tv_nsec;
+}
+
+/// @brief Create a temporary file next to 'path', for a save that replaces 'path' with rename(). Returns its fd, and
+/// its name in 'tmp' (malloc()ed), or -1.
+int editorSaveTemp(const char *path, char **tmp)
+{
+    size_t size = strlen(path) + 12;
+    *tmp = malloc(size);
+    if (*tmp == NULL)
+        return -1;
+    snprintf(*tmp, size, "%s.zen-XXXXXX", path);
+    int fd = mkstemp(*tmp);
+    if (fd == -1)
+    {
+        free(*tmp);
+        return -1;
+    }
+
+    // mkstemp() makes the file private, give it the mode the file had, or the one a new file would get.
+    struct stat st;
+    mode_t mode;
+    if (stat(path, &st) == 0)
+        mode = st.st_mode & 07777;
+    else
+    {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0644 & ~mask;
+    }
+    fchmod(fd, mode);
+    return fd;
+}
+
+/// @brief Write the buffer to E->filename. Returns -1 if it could not be written, the status message says why.
+/*
+    The rows are streamed into a temporary file next to the file, which then replaces it with rename(). So the text is
+    never laid out in memory all at once, whatever the size of the buffer, and a failed save (a full disk) leaves the
+    file as it was. A symbolic link is followed, and the file it points to is replaced. Where no file can be created next
+    to it (a directory we can't write to), the file is overwritten in place instead.
+*/
+int editorSave()
+{
+    if (E->hex)
+        return editorHexSave();
+
+    if (E->filename == NULL)
+    {
+        editorSetStatusMessage("Can't save! The buffer has no file name");
+        return -1;
+    }
+    if (E->partial)
+    {
+        editorSetStatusMessage("Can't save! Only part of the file was loaded");
+        return -1;
+    }
+
+    char *path = realpath(E->filename, NULL);
+    if (path == NULL)
+        path = strdup(E->filename);
+    if (path == NULL)
+    {
+        editorSetStatusMessage("Can't save! Out of memory");
+        return -1;
+    }
+    char *tmp = NULL;
+    int fd = editorSaveTemp(path, &tmp);
+    if (fd == -1)
+    {
+        tmp = NULL;
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd == -1)
+    {
+        editorSetStatusMessage("Can't save! %s: %s", path, strerror(errno));
+        free(path);
+        return -1;
+    }
+
+    // gzclose() closes the fd it was given, so it gets a copy and ours stays open for fsync().
+    int ok = E->compressed ? editorGzipWrite(dup(fd)) == 0 : editorWriteRows(fd) == 0;
+    ok = ok && fsync(fd) == 0 && (tmp == NULL || rename(tmp, path) == 0);
+    if (!ok)
+    {
+        editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+        close(fd);
+        if (tmp)
+            unlink(tmp);
+        free(tmp);
+        free(path);
+        return -1;
+    }
+    free(tmp);
+
+    // Keep the sidecar cache in sync with what is now on disk, the row offsets are just the running row sizes.
+    struct stat st = {0};
+    if (fstat(fd, &st) == 0 && !E->compressed && st.st_size >= ZEN_CACHE_MIN_SIZE)
+    {
+        char *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            uint64_t *offsets = malloc(sizeof(uint64_t) * (E->numrows + 1));
+            uint64_t off = E->bom ? 3 : 0;
+            for (int j = 0; offsets && j < E->numrows; j++)
+            {
+                offsets[j] = off;
+                off += editorRowBytes(&E->row[j]);
+            }
+            if (offsets)
+                editorCacheStore(path, &st, data, offsets);
+            free(offsets);
+            munmap(data, st.st_size);
+        }
+    }
+    close(fd);
+    free(path);
+
+    E->dirty = 0;
+    editorDiskStamp();
+    if (E->compressed)
+        editorSetStatusMessage("%lld bytes compressed and written to disk", E->totalbytes);
+    else
+        editorSetStatusMessage("%lld bytes written to disk", (long long)st.st_size);
+    return 0;
+}
+
+/*** background loading ***/
+
+/*
+    Large files are read by a thread while the user already looks at the first screen. The thread queues the text in
+    chunks and writes a byte to a pipe, the event loop polls that pipe next to the terminal and appends the rows. The row
+    store is only ever touched by the event loop, so rows need no locking: the thread owns the file, the event loop the rows.
+*/
+
+/// @brief Queue a chunk for the event loop, waiting while too much is queued already. Returns 0, and frees the chunk, when the load was stopped.
+int editorLoaderQueue(struct editorLoader *ld, struct loadChunk *chunk)
+{
+    chunk->next = NULL;
+    pthread_mutex_lock(&ld->lock);
+    while (ld->queued >= ZEN_LOAD_QUEUED && !ld->cancel)
+        pthread_cond_wait(&ld->drained, &ld->lock);
+    int cancel = ld->cancel;
+    if (!cancel)
+    {
+        if (ld->tail)
+            ld->tail->next = chunk;
+        else
+            ld->head = chunk;
+        ld->tail = chunk;
+        ld->queued += chunk->len;
+    }
+    pthread_mutex_unlock(&ld->lock);
+    if (cancel)
+    {
+        free(chunk);
+        return 0;
+    }
+    write(ld->notify[1], "c", 1);
+    return 1;
+}
+
+/// @brief Tell the event loop the thread has queued its last chunk.
+void editorLoaderDone(struct editorLoader *ld, int error)
+{
+    pthread_mutex_lock(&ld->lock);
+    ld->done = 1;
+    ld->error = error;
+    pthread_mutex_unlock(&ld->lock);
+    write(ld->notify[1], "d", 1);
+}
+
+/// @brief Decompression thread: inflate the file a chunk at a time and queue the text.
+void *editorGunzipThread(void *arg)
+{
+    struct editorLoader *ld = arg;
+    int error = 0;
+    while (1)
+    {
+        struct loadChunk *chunk = malloc(sizeof(struct loadChunk) + ZEN_LOAD_CHUNK);
+        uint64_t start = editorPerfNow();
+        int n = gzread(ld->gz, chunk->data, ZEN_LOAD_CHUNK);
+        editorTraceSpan("gzread", start, editorPerfNow());
+        if (n <= 0)
+        {
+            free(chunk);
+            error = (n < 0);
+            break;
+        }
+        chunk->len = n;
+        chunk->text = chunk->data;
+        if (!editorLoaderQueue(ld, chunk))
+            break;
+    }
+    editorLoaderDone(ld, error);
+    return NULL;
+}
+
+/// @brief Reader thread for a mapped file: queue it in chunks ending at line breaks, after touching every page of them.
+/// The page faults, and the disk reads behind them, then happen here instead of in the event loop.
+void *editorMapThread(void *arg)
+{
+    struct editorLoader *ld = arg;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t pos = ld->from;
+    while (pos < ld->size)
+    {
+        uint64_t start = editorPerfNow();
+        size_t end = pos + ZEN_LOAD_CHUNK < ld->size ? pos + ZEN_LOAD_CHUNK : ld->size;
+        size_t first = pos & ~(size_t)(page - 1); // The mapping itself is page aligned.
+        madvise((void *)&ld->map[first], end - first, MADV_WILLNEED);
+        volatile char sink = 0;
+        for (size_t p = pos; p < end; p += page)
+            sink ^= ld->map[p];
+        (void)sink;
+
+        const char *nl = memchr(&ld->map[end - 1], '\n', ld->size - end + 1);
+        end = nl ? (size_t)(nl - ld->map) + 1 : ld->size;
+        editorTraceSpan("read_chunk", start, editorPerfNow());
+
+        struct loadChunk *chunk = malloc(sizeof(struct loadChunk));
+        chunk->len = end - pos;
+        chunk->text = &ld->map[pos];
+        if (!editorLoaderQueue(ld, chunk))
+            break;
+        pos = end;
+    }
+    editorLoaderDone(ld, 0);
+    return NULL;
+}
+
+/// @brief Start the loader thread. The rows it queues are appended to the buffer by editorLoadService().
+/// Returns -1, with errno set, if the thread could not be started.
+int editorLoaderStart(void *(*thread)(void *))
+{
+    if (pipe(E->load.notify) == -1)
+        return -1;
+    fcntl(E->load.notify[0], F_SETFL, O_NONBLOCK);
+    E->load.head = E->load.tail = NULL;
+    E->load.queued = E->load.taken = 0;
+    E->load.done = E->load.error = E->load.cancel = 0;
+    E->load.partlen = 0;
+    int err = pthread_create(&E->load.thread, NULL, thread, &E->load);
+    if (err != 0)
+    {
+        close(E->load.notify[0]);
+        close(E->load.notify[1]);
+        errno = err;
+        return -1;
+    }
+    E->load.active = 1;
+    return 0;
+}
+
+/// @brief Start loading the compressed file open on 'fd' into the (empty) buffer. Returns -1, with errno set, on failure.
+int editorGunzipStart(int fd)
+{
+    E->load.gz = gzdopen(fd, "rb");
+    if (E->load.gz == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+    gzbuffer(E->load.gz, 256 * 1024);
+    if (editorLoaderStart(editorGunzipThread) == -1)
+    {
+        gzclose(E->load.gz);
+        return -1;
+    }
+    E->compressed = 1;
+    editorSetStatusMessage("Decompressing... (Esc to stop)");
+    return 0;
+}
+
+/// @brief Load the rest of the mapped file 'data', from 'from' on, in the background. The loader takes over the mapping, and the
+/// line offsets collected so far for the sidecar cache. Returns -1 if the loader could not be started, and the caller keeps both.
+int editorLoadMapStart(const char *data, struct stat *st, size_t from, uint64_t *offsets, size_t n, size_t cap)
+{
+    E->load.map = data;
+    E->load.size = st->st_size;
+    E->load.from = from;
+    E->load.st = *st;
+    E->load.offsets = offsets;
+    E->load.noffsets = n;
+    E->load.offcap = cap;
+    return editorLoaderStart(editorMapThread);
+}
+
+/// @brief Remember where the line at 's' starts in the mapped file, for the sidecar cache.
+void editorLoadOffset(const char *s)
+{
+    if (E->load.noffsets == E->load.offcap)
+    {
+        E->load.offcap *= 2;
+        E->load.offsets = realloc(E->load.offsets, sizeof(uint64_t) * E->load.offcap);
+    }
+    E->load.offsets[E->load.noffsets++] = s - E->load.map;
+}
+
+/// @brief Start loading the rest of the mapped file 'data' in the background from row 'from' of its valid sidecar cache.
+/// The loader takes over the mapping and the cache. Returns -1 if the loader could not be started, and the caller keeps both.
+int editorLoadCacheStart(const char *data, struct stat *st, struct editorCacheHeader *cache, size_t cachelen, uint64_t from)
+{
+    E->load.map = data;
+    E->load.size = st->st_size;
+    E->load.from = ((uint64_t *)(cache + 1))[from];
+    E->load.st = *st;
+    E->load.offsets = NULL;
+    E->load.cache = cache;
+    E->load.cachelen = cachelen;
+    E->load.cached = from;
+    if (editorLoaderStart(editorMapThread) == -1)
+    {
+        E->load.cache = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/// @brief Cut the rows of the cache that start in the chunk at 'data', restoring their comment state. As for the first
+/// screen of a warm open, highlighting is left until the rows are drawn.
+void editorLoadCached(const char *data, size_t len)
+{
+    uint64_t *offsets = (uint64_t *)(E->load.cache + 1);
+    unsigned char *bits = (unsigned char *)(offsets + E->load.cache->numrows);
+    uint64_t end = (data - E->load.map) + len;
+    E->load.taken += len;
+    E->defer_syntax++;
+    for (uint64_t j = E->load.cached; j < E->load.cache->numrows && offsets[j] < end; j++)
+    {
+        editorOpenLine(E->load.map, offsets[j], j + 1 < E->load.cache->numrows ? offsets[j + 1] : E->load.size);
+        E->row[E->numrows - 1].hl_open_comment = (bits[j / 8] >> (j % 8)) & 1;
+        E->load.cached = j + 1;
+    }
+    E->defer_syntax--;
+}
+
+/// @brief Append the text of a chunk as rows. Lines wholly inside the chunk go in with one editorInsertRows().
+void editorLoadAppend(const char *data, size_t len)
+{
+    size_t start = 0;
+    const char *nl;
+
+    if (E->load.cache)
+    {
+        editorLoadCached(data, len);
+        return;
+    }
+
+    // A byte order mark is kept aside and written back on save.
+    if (E->load.taken == 0 && E->numrows == 0 && len >= 3 && !memcmp(data, "\xef\xbb\xbf", 3))
+    {
+        E->bom = 1;
+        start = 3;
+    }
+    E->load.taken += len;
+
+    // Finish the line the previous chunk ended in.
+    if (E->load.partlen)
+    {
+        nl = memchr(data, '\n', len);
+        size_t take = nl ? (size_t)(nl - data) + 1 : len;
+        E->load.partial = realloc(E->load.partial, E->load.partlen + take);
+        memcpy(&E->load.partial[E->load.partlen], data, take);
+        E->load.partlen += take;
+        if (!nl)
+            return;
+        editorOpenLine(E->load.partial, 0, E->load.partlen);
+        E->load.partlen = 0;
+        start = take;
+    }
+
+    size_t cap = 1024, n = 0;
+    struct clipLine *lines = malloc(sizeof(struct clipLine) * cap);
+    while (start < len && (nl = memchr(&data[start], '\n', len - start)) != NULL)
+    {
+        size_t end = nl - data;
+        if (end > start && data[end - 1] == '\r')
+            end--;
+        if (n == cap)
+        {
+            cap *= 2;
+            lines = realloc(lines, sizeof(struct clipLine) * cap);
+        }
+        lines[n].s = (char *)&data[start];
+        lines[n].len = end - start;
+        if (E->load.offsets)
+            editorLoadOffset(&data[start]);
+        n++;
+        start = nl - data + 1;
+    }
+    int first = E->numrows;
+    if (n)
+        editorInsertRows(E->numrows, lines, n);
+    // The lines still point into 'data': a stripped '\r' is right after them.
+    for (size_t i = 0; i < n; i++)
+    {
+        if (lines[i].s[lines[i].len] == '\r')
+            editorRowSetEnding(&E->row[first + i], 1);
+    }
+    free(lines);
+
+    if (start < len)
+    {
+        if (E->load.offsets)
+            editorLoadOffset(&data[start]);
+        E->load.partial = realloc(E->load.partial, len - start);
+        memcpy(E->load.partial, &data[start], len - start);
+        E->load.partlen = len - start;
+    }
+}
+
+/// @brief Stop loading: join the thread and flush the last line. 'cancel' stops it early, keeping the rows loaded so far.
+void editorLoadFinish(int cancel)
+{
+    pthread_mutex_lock(&E->load.lock);
+    E->load.cancel = cancel;
+    pthread_cond_signal(&E->load.drained);
+    pthread_mutex_unlock(&E->load.lock);
+    pthread_join(E->load.thread, NULL);
+
+    struct loadChunk *chunk = E->load.head;
+    while (chunk)
+    {
+        struct loadChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    if (E->load.partlen && !cancel)
+        editorOpenLine(E->load.partial, 0, E->load.partlen);
+    free(E->load.partial);
+    E->load.partial = NULL;
+    E->load.partlen = 0;
+    E->load.head = E->load.tail = NULL;
+
+    int compressed = (E->load.gz != NULL);
+    if (E->load.gz)
+        gzclose(E->load.gz);
+    E->load.gz = NULL;
+    if (E->load.map)
+    {
+        if (!cancel && E->load.offsets)
+            editorCacheStore(E->filename, &E->load.st, E->load.map, E->load.offsets);
+        munmap((void *)E->load.map, E->load.size);
+        free(E->load.offsets);
+        E->load.map = NULL;
+        E->load.offsets = NULL;
+    }
+    if (E->load.cache)
+        munmap(E->load.cache, E->load.cachelen);
+    E->load.cache = NULL;
+    close(E->load.notify[0]);
+    close(E->load.notify[1]);
+    E->load.notify[0] = E->load.notify[1] = -1;
+    E->load.active = 0;
+
+    E->dirty = 0;
+    E->partial = (cancel || E->load.error);
+    if (cancel)
+        editorSetStatusMessage("Loading stopped after %d lines", E->numrows);
+    else if (E->load.error)
+        editorSetStatusMessage("The compressed file is corrupt or truncated, %d lines loaded", E->numrows);
+    else
+        editorSetStatusMessage(compressed ? "Decompressed %d lines" : "Loaded %d lines", E->numrows);
+}
+
+/// @brief The thread queued something: take from the queue and turn it into rows, up to ZEN_LOAD_BUDGET bytes at a time.
+void editorLoadService()
+{
+    char drain[64];
+    while (read(E->load.notify[0], drain, sizeof(drain)) > 0)
+        ;
+
+    pthread_mutex_lock(&E->load.lock);
+    struct loadChunk *chunk = E->load.head, *last = NULL;
+    size_t budget = 0;
+    while (E->load.head && budget < ZEN_LOAD_BUDGET)
+    {
+        last = E->load.head;
+        budget += last->len;
+        E->load.head = last->next;
+    }
+    if (last)
+        last->next = NULL;
+    if (E->load.head == NULL)
+        E->load.tail = NULL;
+    else
+        write(E->load.notify[1], "c", 1); // Come back for the rest once the terminal has been looked at.
+    E->load.queued -= budget;
+    int done = E->load.done && E->load.head == NULL;
+    pthread_cond_signal(&E->load.drained);
+    pthread_mutex_unlock(&E->load.lock);
+
+    while (chunk)
+    {
+        struct loadChunk *next = chunk->next;
+        uint64_t start = editorPerfNow();
+        editorLoadAppend(chunk->text, chunk->len);
+        editorTraceSpan("load_append", start, editorPerfNow());
+        free(chunk);
+        chunk = next;
+    }
+    E->dirty = 0;
+
+    if (done)
+        editorLoadFinish(0);
+    else if (E->load.map)
+        editorSetStatusMessage("Loading: %d%%, %d lines so far (Esc to stop)", (int)((E->load.from + E->load.taken) * 100 / E->load.size), E->numrows);
+    else
+        editorSetStatusMessage("Decompressing: %d lines so far (Esc to stop)", E->numrows);
+}
+
+/// @brief Write the buffer gzip-compressed, streaming the rows through zlib instead of building the whole text first.
+int editorGzipWrite(int fd)
+{
+    gzFile gz = gzdopen(fd, "wb6");
+    if (gz == NULL)
+        return -1;
+    gzbuffer(gz, 256 * 1024);
+    int ok = !E->bom || gzwrite(gz, "\xef\xbb\xbf", 3) == 3;
+    for (int j = 0; j < E->numrows && ok; j++)
+    {
+        if (E->row[j].size)
+            ok = gzwrite(gz, E->row[j].chars, E->row[j].size) == E->row[j].size;
+        if (E->noeol && j == E->numrows - 1)
+            break;
+        ok = ok && (!E->row[j].crlf || gzputc(gz, '\r') != -1) && gzputc(gz, '\n') != -1;
+    }
+    return (gzclose(gz) == Z_OK && ok) ? 0 : -1;
+}
+
+/*** auto-save ***/
+
+/*
+    With --autosave, a copy of the buffer is written to $XDG_CACHE_HOME/zen/<hash>.bak after the buffer has been left alone
+    for a while, or after enough edits. The copy is written by a forked child: it gets a copy-on-write snapshot of the rows
+    for free, so the editor never waits for the disk, however large the buffer is. The event loop only looks at the
+    counters and reaps the child.
+*/
+
+/// @brief Backup file of the current buffer, malloc()ed, or NULL.
+char *editorAutosavePath(int create)
+{
+    return E->filename ? editorCachePath(E->filename, ".bak", create) : NULL;
+}
+
+/// @brief Write the backup from a child process, to a temporary file renamed over the old backup once it is complete.
+void editorAutosaveStart()
+{
+    char *path = editorAutosavePath(1);
+    if (path == NULL)
+        return;
+    // The temporary name is made before fork(), so the child has nothing left to allocate.
+    size_t size = strlen(path) + 5;
+    char *tmp = malloc(size);
+    if (tmp == NULL)
+    {
+        free(path);
+        return;
+    }
+    snprintf(tmp, size, "%s.tmp", path);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        int ok = 0;
+        if (fd != -1 && E->compressed)
+            ok = editorGzipWrite(fd) == 0;
+        else if (fd != -1)
+            ok = editorWriteRows(fd) == 0 && close(fd) == 0;
+        ok = ok && rename(tmp, path) == 0;
+        if (!ok)
+            unlink(tmp);
+        _exit(ok ? 0 : 1); // Not exit(): the atexit() handlers belong to the editor.
+    }
+    free(tmp);
+    free(path);
+    if (pid == -1)
+        return;
+    E->autosave.pid = pid;
+    E->autosave.saved = E->dirty;
+    E->autosave.written = 1;
+}
+
+/// @brief Idle task: reap a finished backup, and start a new one once the buffer has been idle for zenAutosave.seconds or zenAutosave.edits edits were made.
+void editorAutosave()
+{
+    if (E->autosave.pid)
+    {
+        int status;
+        if (waitpid(E->autosave.pid, &status, WNOHANG) != E->autosave.pid)
+            return;
+        E->autosave.pid = 0;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            editorSetStatusMessage("Auto-save failed");
+    }
+    if (!zenAutosave.seconds && !zenAutosave.edits)
+        return;
+
+    // Saved: the backup is not needed anymore.
+    if (E->dirty == 0)
+    {
+        if (E->autosave.written)
+        {
+            char *path = editorAutosavePath(0);
+            if (path)
+                unlink(path);
+            free(path);
+            E->autosave.written = 0;
+        }
+        E->autosave.saved = E->autosave.seen = 0;
+        return;
+    }
+
+    // Rows that are being filled in by a filter command or a load are not worth a backup yet.
+    if (E->hex || E->pipe.pid || E->load.active)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (E->dirty != E->autosave.seen)
+    {
+        E->autosave.seen = E->dirty;
+        E->autosave.changed = now;
+    }
+    if (E->dirty < E->autosave.saved)
+        E->autosave.saved = 0;
+    int edits = E->dirty - E->autosave.saved;
+    if (edits == 0)
+        return;
+    long long idle = (now.tv_sec - E->autosave.changed.tv_sec) * 1000LL + (now.tv_nsec - E->autosave.changed.tv_nsec) / 1000000;
+    if ((zenAutosave.edits && edits >= zenAutosave.edits) || (zenAutosave.seconds && idle >= zenAutosave.seconds * 1000LL))
+        editorAutosaveStart();
+}
+
+/// @brief Point the user at a backup that is newer than the file just opened.
+void editorAutosaveNotice()
+{
+    char *path = editorAutosavePath(0);
+    struct stat bst, fst;
+    if (path && stat(path, &bst) == 0 && stat(E->filename, &fst) == 0 && bst.st_mtime > fst.st_mtime)
+        editorSetStatusMessage("An auto-saved copy newer than this file is in %s", path);
+    free(path);
+}
+
+/*** find ***/
+
+void editorFindCallback(char *query, int key)
+{
+    /*
+        'last_match' will contain the index of the row that the last match was on, or -1 if there was no last match.
+        'direction' will store the direction of the search: 1 for searching forward, and -1 for searching backward.
+        They are kept in the buffer, with the highlighting the match covers, so a search never reaches into another one.
+    */
+    struct editorSearch *fs = &E->search;
+    if (fs->saved_hl)
+    {
+        memcpy(E->row[fs->saved_hl_line].hl, fs->saved_hl, E->row[fs->saved_hl_line].rsize);
+        free(fs->saved_hl);
+        fs->saved_hl = NULL;
+    }
+
+    if (key == '\r' || key == '\x1b')
+    {
+        fs->last_match = -1;
+        fs->direction = 1;
+        return;
+    }
+    else if (key == ARROW_RIGHT || key == ARROW_DOWN)
+    {
+        fs->direction = 1;
+    }
+    else if (key == ARROW_LEFT || key == ARROW_UP)
+    {
+        fs->direction = -1;
+    }
+    else
+    {
+        fs->last_match = -1;
+        fs->direction = 1;
+    }
+
+    if (fs->last_match == -1)
+        fs->direction = 1;
+
+    // 'current' is the index of the current row we are searching. We start on the last_match row.
+    int current = fs->last_match;
+
+    int i;
+    for (i = 0; i < E->numrows; i++)
+    {
+        // If there was a last match, it starts on the line after (or before, if we’re searching backwards).
+        // If there wasn’t a last match, it starts at the top of the file and searches in the forward direction to find the first match.
+        current += fs->direction;
+
+        // Causes current to go from the end of the file back to the beginning of the file, or vice versa, to allow a search to “wrap around” the end of a file and continue from the top (or bottom).
+        if (current == -1)
+            current = E->numrows - 1;
+        else if (current == E->numrows)
+            current = 0;
+
+        // The row to search.
+        erow *row = &E->row[current];
+
+        // check if query is a substring of the current row. It returns NULL if there is no match, otherwise it returns a pointer to the matching substring.
+        char *match = strstr(row->render, query);
+
+        if (match)
+        {
+            editorRowHighlight(row);
+
+            // When we find a match, we set last_match to current, so that if the user presses the arrow keys, we’ll start the next search from that point.
+            fs->last_match = current;
+            E->cy = current;
+            E->cx = editorRowRxToCx(row, match - row->render);
+            E->rowoff = E->wrap ? editorRowToVline(E->numrows) : E->numrows;
+
+            fs->saved_hl_line = current;
+            fs->saved_hl = malloc(row->rsize);
+            memcpy(fs->saved_hl, row->hl, row->rsize);
+
+            // match - row->render is the index into render of the match, so we use that as our index into hl.
+            memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
+            break;
+        }
+    }
+}
+
+/*** append buffer ***/
+
+/// @brief To append a string s to an abuf
+/// @param ab Buffer to append the string onto.
+/// @param s The String to append.
+/// @param len Length of the new string to append in buffer.
+void abAppend(struct abuf *ab, const char *s, int len)
+{
+    char *new = editorRealloc(MEM_OUTPUT, ab->b, ab->len + len); // Create a new buffer of size (afub.len + len) and contents of abuf
+    if (new == NULL)
+        return;
+    memcpy(&new[ab->len], s, len); // Copy contents of s to to new[ab.len].
+    ab->b = new;                   // Make abuf point the new buffer created.
+    ab->len += len;
+}
+
+/// @brief Deallocates the dynamic memory used by an abuf.
+void abFree(struct abuf *ab)
+{
+    editorFree(MEM_OUTPUT, ab->b);
+}
+
+/*** hex view ***/
+
+/// @brief Show 'data' in the hex view. The mapping becomes writable: it is private, so edits stay in memory until saved.
+void editorHexOpen(unsigned char *data, size_t size)
+{
+    mprotect(data, size, PROT_READ | PROT_WRITE);
+    E->hex = calloc(1, sizeof(struct editorHex));
+    E->hex->data = data;
+    E->hex->size = size;
+    E->hex->dirty_lo = size;
+}
+
+void editorHexClose()
+{
+    munmap(E->hex->data, E->hex->size);
+    free(E->hex);
+    E->hex = NULL;
+}
+
+/// @brief Write back the bytes changed since the last save, in place, with a single pwrite().
+int editorHexSave()
+{
+    struct editorHex *h = E->hex;
+    if (h->dirty_lo >= h->dirty_hi)
+    {
+        editorSetStatusMessage("No changes to save");
+        return 0;
+    }
+
+    size_t len = h->dirty_hi - h->dirty_lo;
+    int fd = open(E->filename, O_WRONLY);
+    if (fd != -1 && pwrite(fd, &h->data[h->dirty_lo], len, h->dirty_lo) == (ssize_t)len)
+    {
+        close(fd);
+        h->dirty_lo = h->size;
+        h->dirty_hi = 0;
+        E->dirty = 0;
+        editorDiskStamp();
+        editorSetStatusMessage("%zu bytes written to disk", len);
+        return 0;
+    }
+    if (fd != -1)
+        close(fd);
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    return -1;
+}
+
+/// @brief Switch the buffer between text and the hex view, by reopening the file. Only allowed without unsaved changes.
+void editorHexToggle()
+{
+    if (E->filename == NULL || E->dirty)
+    {
+        editorSetStatusMessage("Save the file before switching views");
+        return;
+    }
+
+    char *filename = strdup(E->filename);
+    if (E->hex)
+    {
+        editorHexClose();
+        if (editorOpenAs(filename, 0) == -1)
+            editorSetStatusMessage("Can't open %s: %s", filename, strerror(errno));
+    }
+    else
+    {
+        editorDelRows(0, E->numrows);
+        E->cx = E->cy = E->rowoff = E->coloff = 0;
+        if (editorOpenAs(filename, 1) == -1)
+            editorSetStatusMessage("Can't open %s: %s", filename, strerror(errno));
+        else if (E->hex == NULL)
+            editorSetStatusMessage("Only regular, non-empty files can be shown in hex");
+    }
+    E->dirty = 0;
+    editorDiskStamp();
+    free(filename);
+}
+
+/*** buffers ***/
+
+/// @brief Allocate a new, empty buffer and make it the current one (E), without touching the terminal.
+struct editorConfig *editorNewBuffer()
+{
+    E = calloc(1, sizeof(struct editorConfig));
+    E->cx = 0;
+    E->cy = 0;
+    E->rx = 0;
+    E->rowoff = 0;
+    E->coloff = 0;
+    E->numrows = 0;
+    E->row = NULL;
+    E->dirty = 0;
+    E->filename = NULL;
+    E->statusmsg[0] = '\0';
+    E->statusmsg_time = 0;
+    E->syntax = NULL;
+    E->wrap = 0;
+    E->wrapidx = (struct rowIndex){NULL, 0, 1, editorRowLayout};
+    E->linenums = 0;
+    E->gutter = 0;
+    E->gutter_min = E->gutter_max = 0;
+    E->byteidx = (struct rowIndex){NULL, 0, 1, editorRowBytes};
+    E->totalbytes = 0;
+    E->status = calloc(1, sizeof(struct statusFields));
+    E->statusbar = NULL;
+    E->statusbar_valid = 0;
+    memset(&E->stats, 0, sizeof(E->stats));
+    E->stats.lenhist = editorMalloc(MEM_STATS, ZEN_STATS_DENSE * sizeof(int));
+    memset(E->stats.lenhist, 0, ZEN_STATS_DENSE * sizeof(int));
+    E->stats_panel = 0;
+    E->defer_syntax = 0;
+    E->batch_lo = E->batch_hi = 0;
+    E->cursors = NULL;
+    E->ncursors = 0;
+    E->cursors_cap = 0;
+    E->sel_active = 0;
+    E->sel_cy = E->sel_cx = 0;
+    E->sel_block = 0;
+    E->hex = NULL;
+    E->compressed = 0;
+    E->crlf = E->bom = E->noeol = 0;
+    E->partial = 0;
+    E->search.last_match = -1;
+    E->search.direction = 1;
+    E->search.saved_hl = NULL;
+    E->load.notify[0] = E->load.notify[1] = -1;
+    pthread_mutex_init(&E->load.lock, NULL);
+    pthread_cond_init(&E->load.drained, NULL);
+    return E;
+}
+
+/// @brief Free the buffer 'ed' and everything it holds. If it was the current buffer, E is left pointing at no buffer.
+void editorFreeBuffer(struct editorConfig *ed)
+{
+    // A live clipboard refers to the current buffer, and the rows about to go would move it.
+    editorClipboardMaterialize();
+    struct editorConfig *prev = E;
+    E = ed;
+    if (E->pipe.pid)
+        editorPipeFinish(1);
+    if (E->load.active)
+        editorLoadFinish(1);
+    if (E->autosave.pid)
+        waitpid(E->autosave.pid, NULL, 0); // The backup being written is still of use.
+    if (E->hex)
+        editorHexClose();
+    editorDelRows(0, E->numrows);
+    editorFree(MEM_ROWS, E->row);
+    rowIndexFree(&E->wrapidx);
+    rowIndexFree(&E->byteidx);
+    free(E->filename);
+    free(E->status);
+    free(E->statusbar);
+    editorFree(MEM_STATS, E->stats.lenhist);
+    editorFree(MEM_STATS, E->stats.longlens);
+    free(E->cursors);
+    free(E->search.saved_hl);
+    pthread_mutex_destroy(&E->load.lock);
+    pthread_cond_destroy(&E->load.drained);
+    free(E);
+    E = (ed == prev) ? NULL : prev;
+}
+
+void editorSetStatusMessage(const char *fmt, ...)
+{
+    /*
+        The ... argument makes editorSetStatusMessage() a variadic function, meaning it can take any number of arguments.
+        C’s way of dealing with these arguments is by having you call va_start() and va_end() on a value of type va_list.
+        The last argument before the ... (in this case, fmt) must be passed to va_start(), so that the address of the next arguments is known.
+        Then, between the va_start() and va_end() calls, you would call va_arg() and pass it the type of the next argument (which you usually get from the given format string) and it would return the value of that argument.
+        In this case, we pass fmt and ap to vsnprintf() and it takes care of reading the format string and calling va_arg() to get each argument.
+    */
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(E->statusmsg, sizeof(E->statusmsg), fmt, ap); // vsnprintf() helps us make our own printf()-style function
+    va_end(ap);
+    E->statusmsg_time = time(NULL); // set E->statusmsg_time to the current time
+}